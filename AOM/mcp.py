@@ -3,6 +3,7 @@
 Support for QuadAOM - 4-channel AOM driver from AA Opto with enhanced GUI
 """
 
+import os
 import re
 import threading
 import time
@@ -14,21 +15,57 @@ from devices.zeromq_device import (
     include_remote_methods,
     remote,
 )
+from devices.async_calls import AsyncOperationsMixin
+from devices.background_init import BackgroundInitMixin
+from devices.metrics import MetricsMixin
+from devices.status_delta import DeltaStatusMixin
+from devices.ui_updates import RenderCache, StatusThrottle
 from PyQt5 import QtCore, QtGui, QtWidgets
 
+# Reply to the "S" query: four "l<ch>" lines then four "b<ch>" lines, ending with the "?" prompt
+_CHANNEL_LINE = r"\n\rl\d\s+F=(\d+\.?\d*)\s+P=(-?\d+\.?\d*)\s+([A-Z]+)\s+([A-Z]+)"
+_BLANKING_LINE = r"\n\rb\d\s+([A-Z]+)\s+([A-Z]+)"
+_STATUS_RE = re.compile(r"^" + _CHANNEL_LINE * 4 + _BLANKING_LINE * 4 + r"\n\r\?$")
 
-class QuadAOMWorker(DeviceWorker):
+
+def _echoes(reply, cmd):
+    """ The device echoes a command it accepted; anything else (the "?" prompt, noise) is a rejection """
+    return cmd.strip() in reply
+
+
+class QuadAOMWorker(DeltaStatusMixin, MetricsMixin, AsyncOperationsMixin, BackgroundInitMixin, DeviceWorker):
     """ Worker class for 4-channel AOM driver by AA Opto """
+    _POWER_DB_MIN = -5.2
+    _POWER_DB_MAX = 33.0
 
-    def __init__(self, comport=None, *args, **kwargs):
-        """ comport: COM1, COM2, ... """
+    def __init__(self, comport=None, status_interval=1.0, calibration_dir=None, *args, **kwargs):
+        """ comport: COM1, COM2, ...
+            status_interval: seconds a channel's cached state is trusted before status() re-reads the device
+            calibration_dir: where channel<N>.npz calibration tables are kept (default: calibration/ next to this file) """
         super().__init__(*args, **kwargs)
         if comport is None:
             raise Exception("Error - you should specify COM port as comport parameter in the config file")
 
         self._comport = comport
-
-    def init_device(self):
+        self._status_interval = float(status_interval)
+        self._status_cache = {}
+        self._channel_stamps = {ch: 0.0 for ch in range(1, 5)}
+        # Last acknowledged value of every field, kept as the exact token sent on the wire
+        # ("L" holds F/H/P/D/O/I of the L<ch> command, "B" holds O/I of B<ch>)
+        self._channel_model = {ch: {"L": {}, "B": {}} for ch in range(1, 5)}
+
+        # Serializes access to the port between remote calls, status() and the ramp writer thread
+        self._serial_lock = threading.RLock()
+        self._ramp_thread = None
+        self._ramp_stop = threading.Event()
+        self._ramp_report = {}
+
+        if calibration_dir is None:
+            calibration_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "calibration")
+        self._calibration_dir = calibration_dir
+        self._calibrations = {}
+
+    def _init_hardware(self):
         """ Initializes connection with the device """
         import serial
         print(self._comport)
@@ -42,91 +79,393 @@ class QuadAOMWorker(DeviceWorker):
 
     @remote
     def _send_msg(self, msg, reply_pattern=".*\n\r"):
-        self.ser.reset_input_buffer()
-        self.ser.write(msg.encode('ascii'))
-
-        buf = self.ser.read()
-        while not re.match(reply_pattern.encode('ascii'), buf):
-            if reply_pattern.endswith('\?$'):
-                new_data = self.ser.read_until(b'?')
-            else:
-                new_data = self.ser.read()
+        # Replies end either at the "?" prompt or at the first line break
+        terminator = b'?' if reply_pattern.endswith('\?$') else b'\n\r'
+        waited = time.perf_counter()
+        with self._serial_lock:
+            self._metrics.observe("serial_lock_wait", time.perf_counter() - waited)
+            self.ser.reset_input_buffer()
+            with self._metrics.timed("serial_write"):
+                self.ser.write(msg.encode('ascii'))
+            return self._read_reply(re.compile(reply_pattern), terminator)
+
+    def _read_reply(self, pattern, terminator):
+        """ Reads whatever is waiting in bulk and only tries the pattern once a terminator has
+            arrived, instead of re-matching the whole buffer after every byte """
+        buf = bytearray()
+        searched = 0
+        sent_at = time.perf_counter()
+        while True:
+            new_data = self.ser.read(self.ser.in_waiting or 1)
             if len(new_data) == 0:
-                print(f"Buf ({len(buf)}): {buf}")
-                raise IOError(f"The device did not send the expected response (got: {repr(buf)}, expected: {repr(reply_pattern)}")
+                self._metrics.count("timeouts")
+                print(f"Buf ({len(buf)}): {bytes(buf)}")
+                raise IOError(f"The device did not send the expected response (got: {repr(bytes(buf))}, expected: {repr(pattern.pattern)}")
+            if not buf:
+                self._metrics.observe("first_byte", time.perf_counter() - sent_at)
             buf += new_data
-        return re.match(reply_pattern, buf.decode('ascii'))
+            # Only scan the new bytes (plus an overlap in case the terminator straddles two chunks)
+            found = buf.find(terminator, max(0, searched - len(terminator) + 1))
+            searched = len(buf)
+            if found < 0:
+                continue
+            with self._metrics.timed("parse"):
+                reply = pattern.match(buf.decode('ascii'))
+            if reply is not None:
+                self._metrics.observe("round_trip", time.perf_counter() - sent_at)
+                return reply
 
     def status(self):
+        """ Serves the cached channel state; the device is only queried once a
+            channel's state is older than status_interval """
         d = super().status()
-        d.update(self.read_status_from_device())
-        return d
+        if not self._device_ready():
+            return self._publish_status(d)
+        d["ramp"] = self.ramp_status()
+        if d["ramp"].get("running") and self._status_cache:
+            # Don't steal the port from a running ramp; the cache is refreshed when it ends
+            d.update({key: dict(value) for key, value in self._status_cache.items()})
+            return self._publish_status(d)
+        now = time.monotonic()
+        if not self._status_cache or any(now - stamp >= self._status_interval
+                                         for stamp in self._channel_stamps.values()):
+            self.read_status_from_device()
+        d.update({key: dict(value) for key, value in self._status_cache.items()})
+        return self._publish_status(d)
 
     @remote
     def read_status_from_device(self):
-        pattern = "^\n\rl1\s+F=(\d+\.?\d*)\s+P=(-?\d+\.?\d*)\s+([A-Z]+)\s+([A-Z]+)" \
-                  "\n\rl2\s+F=(\d+\.?\d*)\s+P=(-?\d+\.?\d*)\s+([A-Z]+)\s+([A-Z]+)" \
-                  "\n\rl3\s+F=(\d+\.?\d*)\s+P=(-?\d+\.?\d*)\s+([A-Z]+)\s+([A-Z]+)" \
-                  "\n\rl4\s+F=(\d+\.?\d*)\s+P=(-?\d+\.?\d*)\s+([A-Z]+)\s+([A-Z]+)" \
-                  "\n\rb1\s+([A-Z]+)\s+([A-Z]+)" \
-                  "\n\rb2\s+([A-Z]+)\s+([A-Z]+)" \
-                  "\n\rb3\s+([A-Z]+)\s+([A-Z]+)" \
-                  "\n\rb4\s+([A-Z]+)\s+([A-Z]+)" \
-                  "\n\r\?$"
-        reply = self._send_msg("S", reply_pattern=pattern)
-        d = {}
+        """ Reads the full "S" dump, refreshing the cache for all channels """
+        waited = time.perf_counter()
+        with self._serial_lock:
+            self._metrics.observe("serial_lock_wait", time.perf_counter() - waited)
+            self.ser.reset_input_buffer()
+            with self._metrics.timed("serial_write"):
+                self.ser.write(b"S")
+            reply = self._read_reply(_STATUS_RE, b"?")
+
+        groups = reply.groups()
+        now = time.monotonic()
         for ch in range(1,5):
-            d[f"channel{ch}"] = {"frequency": float(reply.group(1+4*(ch-1))),
-                                 "power": float(reply.group(2+4*(ch-1))),
-                                 "power_state": reply.group(3+4*(ch-1)) == 'ON',
-                                 "power_control": reply.group(4+4*(ch-1)),
-                                 "blanking_state": reply.group(17+2*(ch-1)) == 'ON',
-                                 "blanking_control": reply.group(18+2*(ch-1))}
-        return d
+            self._status_cache[f"channel{ch}"] = {"frequency": float(groups[4*(ch-1)]),
+                                                  "power": float(groups[1+4*(ch-1)]),
+                                                  "power_state": groups[2+4*(ch-1)] == 'ON',
+                                                  "power_control": groups[3+4*(ch-1)],
+                                                  "blanking_state": groups[16+2*(ch-1)] == 'ON',
+                                                  "blanking_control": groups[17+2*(ch-1)]}
+            self._channel_stamps[ch] = now
+            self._sync_model_from_status(ch, self._status_cache[f"channel{ch}"])
+        return {key: dict(value) for key, value in self._status_cache.items()}
+
+    def _sync_model_from_status(self, channel, data):
+        """ The device readback is authoritative for every field it reports """
+        model = self._channel_model[channel]
+        power = f"{data['power']:.2f}"
+        known = model["L"].get("D")
+        if known is not None and known != power:
+            model["L"].pop("P", None)  # power changed behind our back, raw value is stale
+        # After a raw power write only "P" is known; the readback just adds its dB view
+        model["L"]["D"] = power
+        model["L"]["F"] = f"{data['frequency']:.2f}"
+        model["L"]["O"] = "1" if data["power_state"] else "0"
+        model["L"]["I"] = "1" if data["power_control"] == "INT" else "0"
+        model["B"]["O"] = "1" if data["blanking_state"] else "0"
+        model["B"]["I"] = "1" if data["blanking_control"].startswith("INT") else "0"
+
+    def _send_changed(self, prefix, channel, tokens, force):
+        """ Sends only the tokens that differ from the model, merged into one command.
+            The model is updated once the device echoes the command; if it doesn't, the fields
+            sent are dropped from the model and IOError is raised. Returns the tokens sent. """
+        model = self._channel_model[channel][prefix]
+        changed = [(key, value) for key, value in tokens if force or model.get(key) != value]
+        if not changed:
+            return {}
+        cmd = f"{prefix}{channel}" + "".join(key + value for key, value in changed) + '\r'
+        print(cmd)
+        reply = self._send_msg(cmd).group(0)
+        changed = dict(changed)
+        if not _echoes(reply, cmd):
+            # The device state is unknown now: forget what we sent and re-read the channel
+            for key in changed:
+                model.pop(key, None)
+            if "P" in changed or "D" in changed:
+                model.pop("P", None)
+                model.pop("D", None)
+            self._channel_stamps[channel] = 0.0
+            self._metrics.count("echo_errors")
+            raise IOError(f"The device did not accept {repr(cmd)} (got: {repr(reply)})")
+        model.update(changed)
+        # Raw and dB power are two views of one setting; only the last one written is known
+        if "P" in changed:
+            model.pop("D", None)
+        elif "D" in changed:
+            model.pop("P", None)
+        return changed
+
+    def _update_cached_channel(self, channel, known, **fields):
+        """ Applies values we just wrote to the cache. known=False means the write
+            touched something we can't model, so the channel is re-read next status() """
+        cached = self._status_cache.get(f"channel{channel}")
+        if cached is None:
+            return
+        cached.update(fields)
+        self._channel_stamps[channel] = time.monotonic() if known else 0.0
 
     @remote
-    def configure_channel(self, channel:int, frequency_mhz=None, power_raw=None, power_db=None, phase=None, switch=None, internal_mode=None):
+    def configure_channel(self, channel:int, frequency_mhz=None, power_raw=None, power_db=None, phase=None, switch=None, internal_mode=None, force=False):
+        """ Only fields that differ from the last acknowledged state are sent; force=True resends all given fields.
+            Returns True if anything was written to the device. """
         if channel not in {1, 2, 3, 4}:
             raise Exception(f"Wrong channel number: {channel}. Expected value from 1-4")
-        cmd = f'L{channel}'
+        tokens = []
         if frequency_mhz is not None:
             if frequency_mhz < 85 or frequency_mhz > 135:
                 raise ValueError(f"Wrong frequency: {frequency_mhz}. Expected value between 85 and 135 MHz")
-            cmd += f"F{frequency_mhz:.2f}"
+            tokens.append(("F", f"{frequency_mhz:.2f}"))
         if phase is not None:
             if phase < 0 or phase > 16383:
                 raise ValueError(f"Wrong phase: {phase}. Expected value between 0 and 16383")
-            cmd += f"H{int(phase)}" # Assuming 'H' is the command for phase
+            tokens.append(("H", f"{int(phase)}")) # Assuming 'H' is the command for phase
         if power_raw is not None:
             if power_raw < 0 or power_raw > 1023:
                 raise ValueError(f"Wrong power: {power_raw}. Expected value between 0 and 1023")
-            cmd += f"P{int(power_raw)}"
+            tokens.append(("P", f"{int(power_raw)}"))
         if power_db is not None:
             # Assuming a valid range for power_db, the original check was incomplete
             if power_db < self._POWER_DB_MIN or power_db > self._POWER_DB_MAX:
                 raise ValueError(f"Wrong power: {power_db}.")
-            cmd += f"D{power_db:.2f}"
+            tokens.append(("D", f"{power_db:.2f}"))
         if switch is not None:
-            cmd += "O1" if switch else "O0"
+            tokens.append(("O", "1" if switch else "0"))
         if internal_mode is not None:
-            cmd += "I1" if internal_mode else "I0"
-        cmd += '\r'
-        print(cmd)
-        self._send_msg(cmd)
+            tokens.append(("I", "1" if internal_mode else "0"))
+
+        changed = self._send_changed("L", channel, tokens, force)
+        if not changed:
+            return False
+
+        fields = {}
+        if "F" in changed:
+            fields["frequency"] = float(changed["F"])
+        if "D" in changed:
+            fields["power"] = float(changed["D"])
+        if "O" in changed:
+            fields["power_state"] = changed["O"] == "1"
+        if "I" in changed:
+            fields["power_control"] = "INT" if changed["I"] == "1" else "EXT"
+        # Raw power and phase are not reported back in the same form, so trust the device for those
+        self._update_cached_channel(channel, "P" not in changed and "H" not in changed, **fields)
+        return True
 
     @remote
-    def configure_blanking(self, channel:int, blanking_on=None, internal_control=None):
-        """Configure blanking settings for a channel"""
+    def configure_blanking(self, channel:int, blanking_on=None, internal_control=None, force=False):
+        """Configure blanking settings for a channel, sending only fields that changed"""
         if channel not in {1, 2, 3, 4}:
             raise Exception(f"Wrong channel number: {channel}. Expected value from 1-4")
-        cmd = f'B{channel}'
+        tokens = []
         if blanking_on is not None:
-            cmd += "O1" if blanking_on else "O0"
+            tokens.append(("O", "1" if blanking_on else "0"))
         if internal_control is not None:
-            cmd += "I1" if internal_control else "I0"
-        cmd += '\r'
-        print(cmd)
-        self._send_msg(cmd)
+            tokens.append(("I", "1" if internal_control else "0"))
+
+        changed = self._send_changed("B", channel, tokens, force)
+        if not changed:
+            return False
+
+        fields = {}
+        if "O" in changed:
+            fields["blanking_state"] = changed["O"] == "1"
+        # The control mode label format is device specific, so a mode change forces a re-read
+        self._update_cached_channel(channel, "I" not in changed, **fields)
+        return True
+
+    def _calibration_path(self, channel):
+        return os.path.join(self._calibration_dir, f"channel{channel}.npz")
+
+    def _calibration(self, channel):
+        """ Returns the channel's calibration arrays, loading them from disk on first use """
+        if channel not in {1, 2, 3, 4}:
+            raise Exception(f"Wrong channel number: {channel}. Expected value from 1-4")
+        if channel not in self._calibrations:
+            path = self._calibration_path(channel)
+            if not os.path.exists(path):
+                raise ValueError(f"Channel {channel} is not calibrated ({path} not found)")
+            with np.load(path) as data:
+                self._calibrations[channel] = {key: data[key] for key in data.files}
+        return self._calibrations[channel]
+
+    @remote
+    def save_calibration(self, channel:int, power_raw, optical_power, frequency_mhz=None, efficiency=None):
+        """ Stores a measured response curve for a channel.
+            power_raw / optical_power: raw setting and the optical power measured at it (any unit, used consistently)
+            frequency_mhz / efficiency: optional diffraction efficiency curve over frequency """
+        if channel not in {1, 2, 3, 4}:
+            raise Exception(f"Wrong channel number: {channel}. Expected value from 1-4")
+        power_raw = np.asarray(power_raw, dtype=float).ravel()
+        optical_power = np.asarray(optical_power, dtype=float).ravel()
+        if power_raw.size < 2 or power_raw.size != optical_power.size:
+            raise ValueError("Calibration needs at least two (power_raw, optical_power) pairs of equal length")
+        order = np.argsort(power_raw)
+        power_raw, optical_power = power_raw[order], optical_power[order]
+        # The curve is inverted for lookups, so it has to be strictly increasing
+        if np.any(np.diff(power_raw) <= 0) or np.any(np.diff(optical_power) <= 0):
+            raise ValueError("Optical power must increase strictly with power_raw (repeat or drop saturated points)")
+        arrays = {"power_raw": power_raw, "optical_power": optical_power}
+
+        if frequency_mhz is not None:
+            frequency_mhz = np.asarray(frequency_mhz, dtype=float).ravel()
+            efficiency = np.asarray(efficiency, dtype=float).ravel()
+            if frequency_mhz.size < 2 or frequency_mhz.size != efficiency.size:
+                raise ValueError("Efficiency curve needs at least two (frequency, efficiency) pairs of equal length")
+            order = np.argsort(frequency_mhz)
+            arrays.update(frequency_mhz=frequency_mhz[order], efficiency=efficiency[order])
+
+        os.makedirs(self._calibration_dir, exist_ok=True)
+        np.savez_compressed(self._calibration_path(channel), **arrays)
+        self._calibrations[channel] = arrays
+        print(f"Saved calibration for channel {channel} ({power_raw.size} points)")
+
+    @remote
+    def get_calibration(self, channel:int):
+        """ Returns the stored calibration as lists, or None if the channel is not calibrated """
+        try:
+            return {key: value.tolist() for key, value in self._calibration(channel).items()}
+        except ValueError:
+            return None
+
+    @remote
+    def optical_to_raw(self, channel:int, optical_power):
+        """ Interpolates the raw setting for an optical power, or for a whole list/array in one call """
+        cal = self._calibration(channel)
+        values = np.asarray(optical_power, dtype=float)
+        low, high = cal["optical_power"][0], cal["optical_power"][-1]
+        if np.any(values < low) or np.any(values > high):
+            raise ValueError(f"Optical power outside the calibrated range {low}..{high}")
+        raw = np.rint(np.interp(values, cal["optical_power"], cal["power_raw"]))
+        return raw.tolist() if values.ndim else float(raw)
+
+    @remote
+    def efficiency_at(self, channel:int, frequency_mhz):
+        """ Interpolated diffraction efficiency at one or more frequencies """
+        cal = self._calibration(channel)
+        if "frequency_mhz" not in cal:
+            raise ValueError(f"Channel {channel} has no efficiency calibration")
+        values = np.asarray(frequency_mhz, dtype=float)
+        efficiency = np.interp(values, cal["frequency_mhz"], cal["efficiency"])
+        return efficiency.tolist() if values.ndim else float(efficiency)
+
+    @remote
+    def set_optical_power(self, channel:int, optical_power):
+        """ Sets the channel straight to a calibrated optical power """
+        return self.configure_channel(channel, power_raw=self.optical_to_raw(channel, optical_power))
+
+    _RAMP_FIELDS = {"power_raw": ("P", 0, 1023, "{:.0f}"),
+                    "power_db": ("D", _POWER_DB_MIN, _POWER_DB_MAX, "{:.2f}"),
+                    "frequency": ("F", 85, 135, "{:.2f}")}
+
+    @remote
+    def play_ramp(self, channel:int, values, dwell_ms, field="power_raw", wait_ack=True):
+        """ Steps one field of a channel through values, one point every dwell_ms, from a writer thread.
+            field: "power_raw", "power_db", "frequency" or "optical" (mapped to power_raw through the calibration)
+            wait_ack: check the device's echo after every point and stop at the first one it rejects;
+                      False writes back to back on the
+                      schedule and discards the echoes afterwards (only safe if the device keeps up)
+            Returns immediately; progress and achieved timing are reported by ramp_status() """
+        if channel not in {1, 2, 3, 4}:
+            raise Exception(f"Wrong channel number: {channel}. Expected value from 1-4")
+        if field == "optical":
+            values, field = self.optical_to_raw(channel, np.asarray(values, dtype=float).ravel()), "power_raw"
+        if field not in self._RAMP_FIELDS:
+            raise ValueError(f"Wrong ramp field: {field}. Expected one of {list(self._RAMP_FIELDS)}")
+        if self._ramp_thread is not None and self._ramp_thread.is_alive():
+            raise RuntimeError("A ramp is already running")
+        key, low, high, fmt = self._RAMP_FIELDS[field]
+        values = np.asarray(values, dtype=float).ravel()
+        if values.size == 0:
+            raise ValueError("Empty ramp")
+        if np.any(values < low) or np.any(values > high):
+            raise ValueError(f"Ramp values out of range {low}..{high} for {field}")
+
+        # Format every command up front so the writer loop only writes bytes
+        tokens = [fmt.format(v) for v in values]
+        commands = [f"L{channel}{key}{token}\r".encode('ascii') for token in tokens]
+        self._ramp_stop.clear()
+        self._ramp_report = {"running": True, "channel": channel, "field": field,
+                             "index": 0, "total": len(commands), "dwell_ms": float(dwell_ms)}
+        self._ramp_thread = threading.Thread(target=self._ramp_loop,
+                                             args=(channel, key, tokens, commands, float(dwell_ms) / 1000, wait_ack),
+                                             daemon=True)
+        self._ramp_thread.start()
+        return True
+
+    def _ramp_loop(self, channel, key, tokens, commands, dwell, wait_ack):
+        sent = np.zeros(len(commands))
+        count = 0
+        error = None
+        # Echoes are left unread in pipelined mode, so nobody else may use the port meanwhile
+        if not wait_ack:
+            self._serial_lock.acquire()
+        try:
+            self.ser.reset_input_buffer()
+            start = time.perf_counter()
+            for i, cmd in enumerate(commands):
+                if self._ramp_stop.is_set():
+                    break
+                # Absolute schedule, so a late point doesn't push back all the following ones
+                delay = start + i * dwell - time.perf_counter()
+                if delay > 0:
+                    time.sleep(delay)
+                with self._serial_lock:
+                    sent[i] = time.perf_counter() - start
+                    self.ser.write(cmd)
+                    if wait_ack:
+                        reply = self.ser.read_until(b"\n\r")
+                        if not reply.endswith(b"\n\r") or not _echoes(reply.decode("ascii", "replace"),
+                                                                      cmd.decode("ascii")):
+                            raise IOError(f"No echo for ramp point {i} (got: {repr(reply)})")
+                count = i + 1
+                self._ramp_report["index"] = count
+            if not wait_ack:
+                self.ser.flush()
+                time.sleep(0.05)
+                self.ser.reset_input_buffer()
+        except Exception as e:
+            error = str(e)
+            self._metrics.error("ramp", e)
+            print(f"Ramp on channel {channel} aborted: {e}")
+        finally:
+            if not wait_ack:
+                self._serial_lock.release()
+
+        model = self._channel_model[channel]["L"]
+        model.pop(key, None)
+        if key in ("P", "D"):
+            model.pop("D" if key == "P" else "P", None)
+        # Without echoes we can't be sure which point the device ended on
+        if count and wait_ack and error is None:
+            model[key] = tokens[count - 1]
+        self._channel_stamps[channel] = 0.0  # re-read the channel once the ramp is over
+
+        report = {"running": False, "index": count, "error": error}
+        if count > 1:
+            intervals = np.diff(sent[:count]) * 1000
+            report.update({"elapsed_ms": float(sent[count - 1] * 1000),
+                           "mean_dwell_ms": float(intervals.mean()),
+                           "max_dwell_ms": float(intervals.max()),
+                           "max_lag_ms": float(np.max(sent[:count] - np.arange(count) * dwell) * 1000)})
+        self._ramp_report.update(report)
+
+    @remote
+    def ramp_status(self):
+        """ Progress of the current or last ramp, with achieved timing once it finished """
+        return dict(self._ramp_report)
+
+    @remote
+    def stop_ramp(self):
+        self._ramp_stop.set()
+        if self._ramp_thread is not None:
+            self._ramp_thread.join(timeout=2)
+        return self.ramp_status()
 
     @remote
     def debug_mess(self, message):
@@ -143,8 +482,10 @@ class QuadAOM(DeviceOverZeroMQ):
     _POWER_DB_MIN = -5.2
     _POWER_DB_MAX = 33.0
 
-    def __init__(self, *args, **kwargs):
+    def __init__(self, *args, max_ui_rate=20.0, **kwargs):
+        """ max_ui_rate: dock repaints per second at most """
         super().__init__(*args, **kwargs)
+        self._max_ui_rate = float(max_ui_rate)
 
         # Parent widget for dialogs
         self._parent_widget = None
@@ -157,6 +498,11 @@ class QuadAOM(DeviceOverZeroMQ):
         # Current channel being controlled
         self._current_channel = 1
 
+        # Status messages are merged as they arrive and rendered at most max_ui_rate times per second
+        self._status_throttle = None
+        # Widget setters skip values that are already on screen
+        self._render = RenderCache()
+
     def _create_status_display(self, parent, label, min_val, max_val, suffix="", precision=1):
         """Helper method to create a progress bar for status display"""
         progress = QtWidgets.QProgressBar()
@@ -431,14 +777,105 @@ class QuadAOM(DeviceOverZeroMQ):
         return control_group
 
     def _open_calibrate_window(self):
-        """Opens an empty calibration pop-up window."""
+        """Opens the power calibration window for the current channel.
+        Raw settings are stepped one row at a time and the measured optical power is typed in."""
+        channel = self._current_channel
         dialog = QtWidgets.QDialog(self._parent_widget)
-        dialog.setWindowTitle("Calibration")
-        dialog.setMinimumSize(300, 200)
+        dialog.setWindowTitle(f"Calibration - Channel {channel}")
+        dialog.setMinimumSize(360, 420)
         layout = QtWidgets.QVBoxLayout(dialog)
-        label = QtWidgets.QLabel("Calibration window is under construction.")
-        label.setAlignment(QtCore.Qt.AlignCenter)
-        layout.addWidget(label)
+
+        # Raw points to measure
+        range_layout = QtWidgets.QHBoxLayout()
+        range_layout.addWidget(QtWidgets.QLabel("Raw from"))
+        start_spin = QtWidgets.QSpinBox()
+        start_spin.setRange(0, 1023)
+        range_layout.addWidget(start_spin)
+        range_layout.addWidget(QtWidgets.QLabel("to"))
+        stop_spin = QtWidgets.QSpinBox()
+        stop_spin.setRange(0, 1023)
+        stop_spin.setValue(1023)
+        range_layout.addWidget(stop_spin)
+        range_layout.addWidget(QtWidgets.QLabel("points"))
+        points_spin = QtWidgets.QSpinBox()
+        points_spin.setRange(2, 200)
+        points_spin.setValue(12)
+        range_layout.addWidget(points_spin)
+        generate_button = QtWidgets.QPushButton("Generate")
+        range_layout.addWidget(generate_button)
+        layout.addLayout(range_layout)
+
+        table = QtWidgets.QTableWidget(0, 2)
+        table.setHorizontalHeaderLabels(["Power raw", "Measured power"])
+        table.horizontalHeader().setStretchLastSection(True)
+        layout.addWidget(table)
+
+        def fill(raws, measured=None):
+            table.setRowCount(len(raws))
+            for row, raw in enumerate(raws):
+                table.setItem(row, 0, QtWidgets.QTableWidgetItem(f"{int(raw)}"))
+                table.setItem(row, 1, QtWidgets.QTableWidgetItem("" if measured is None else f"{measured[row]:g}"))
+
+        def generate():
+            fill(np.unique(np.rint(np.linspace(start_spin.value(), stop_spin.value(), points_spin.value()))))
+
+        def set_row():
+            row = table.currentRow()
+            if row >= 0:
+                self.configure_channel(channel, power_raw=int(table.item(row, 0).text()))
+
+        def save():
+            try:
+                raws, measured = [], []
+                for row in range(table.rowCount()):
+                    item = table.item(row, 1)
+                    if item is not None and item.text().strip():
+                        raws.append(float(table.item(row, 0).text()))
+                        measured.append(float(item.text()))
+                self.save_calibration(channel, raws, measured)
+                status_label.setText(f"Saved {len(raws)} points")
+            except Exception as e:
+                status_label.setText(f"Error: {e}")
+
+        def apply_optical():
+            try:
+                self.set_optical_power(channel, float(optical_input.text()))
+                status_label.setText(f"Set raw {self.optical_to_raw(channel, float(optical_input.text())):.0f}")
+            except Exception as e:
+                status_label.setText(f"Error: {e}")
+
+        generate_button.clicked.connect(generate)
+
+        buttons_layout = QtWidgets.QHBoxLayout()
+        set_button = QtWidgets.QPushButton("Set selected")
+        set_button.clicked.connect(set_row)
+        buttons_layout.addWidget(set_button)
+        save_button = QtWidgets.QPushButton("Save")
+        save_button.clicked.connect(save)
+        buttons_layout.addWidget(save_button)
+        layout.addLayout(buttons_layout)
+
+        # Direct optical power setting through the stored table
+        optical_layout = QtWidgets.QHBoxLayout()
+        optical_layout.addWidget(QtWidgets.QLabel("Optical power:"))
+        optical_input = QtWidgets.QLineEdit()
+        optical_input.setValidator(QtGui.QDoubleValidator())
+        optical_layout.addWidget(optical_input)
+        optical_button = QtWidgets.QPushButton("Apply")
+        optical_button.clicked.connect(apply_optical)
+        optical_layout.addWidget(optical_button)
+        layout.addLayout(optical_layout)
+
+        status_label = QtWidgets.QLabel("")
+        layout.addWidget(status_label)
+
+        calibration = self.get_calibration(channel)
+        if calibration:
+            fill(calibration["power_raw"], calibration["optical_power"])
+            status_label.setText(f"Loaded {len(calibration['power_raw'])} points")
+        else:
+            generate()
+
         dialog.exec_()
 
     def _open_presets_window(self):
@@ -462,7 +899,7 @@ class QuadAOM(DeviceOverZeroMQ):
     def _load_channel_settings(self, channel):
         """Load settings for the specified channel into the control widgets"""
         try:
-            status = self.status()
+            status = self.full_status()
             channel_data = status[f'channel{channel}']
 
             # Update controls with current channel settings
@@ -591,57 +1028,67 @@ class QuadAOM(DeviceOverZeroMQ):
         self._load_channel_settings(1)
 
         # Create listener thread for updates
+        self._ui_timer = QtCore.QTimer(dock)
+        self._ui_timer.setSingleShot(True)
+        self._status_throttle = StatusThrottle(self._render_status, self._ui_timer, self._max_ui_rate)
+        self._ui_timer.timeout.connect(self._status_throttle.flush)
         self.createListenerThread(self.updateSlot)
 
     def updateSlot(self, status):
         """This function receives periodic updates from the worker"""
+        self._status_throttle.push(status)
+
+    def _render_status(self, status, changed):
+        render = self._render
         try:
             for ch in range(1, 5):
+                if f'channel{ch}' not in changed:
+                    continue
                 channel_data = status[f'channel{ch}']
 
                 # Update frequency progress bar
                 freq_value = channel_data['frequency']
                 freq_progress = self._current_frequency_progresses[ch]
-                freq_progress.setValue(int(freq_value * 10))
-                freq_progress.setFormat(f"F: {freq_value:.1f}MHz")
+                render.set(freq_progress, "setValue", int(freq_value * 10))
+                render.set(freq_progress, "setFormat", f"F: {freq_value:.1f}MHz")
 
                 # Update power progress bar
                 power_db = channel_data['power']
                 power_progress = self._current_power_progresses[ch]
-                power_progress.setValue(int(power_db * 10))
-                power_progress.setFormat(f"P: {power_db:.1f}dB")
+                render.set(power_progress, "setValue", int(power_db * 10))
+                render.set(power_progress, "setFormat", f"P: {power_db:.1f}dB")
 
                 # Color code the power progress bar
                 if power_db > 25:
-                    power_progress.setStyleSheet("QProgressBar::chunk { background-color: #ff0000; }")
+                    render.set(power_progress, "setStyleSheet", "QProgressBar::chunk { background-color: #ff0000; }")
                 elif power_db > 15:
-                    power_progress.setStyleSheet("QProgressBar::chunk { background-color: #ff9900; }")
+                    render.set(power_progress, "setStyleSheet", "QProgressBar::chunk { background-color: #ff9900; }")
                 else:
-                    power_progress.setStyleSheet("QProgressBar::chunk { background-color: #00aa00; }")
+                    render.set(power_progress, "setStyleSheet", "QProgressBar::chunk { background-color: #00aa00; }")
 
                 # Update status indicators
                 indicators = self._status_indicators[ch]
 
                 # Power indicator
-                indicators['power'].setStyleSheet(
+                render.set(indicators['power'], "setStyleSheet",
                     f"background-color: {'#66ff66' if channel_data['power_state'] else '#ff6666'}; "
                     "border: 1px solid black; font-size: 9px; font-weight: bold;"
                 )
 
                 # Blanking indicator
-                indicators['blanking'].setStyleSheet(
+                render.set(indicators['blanking'], "setStyleSheet",
                     f"background-color: {'#66ff66' if channel_data['blanking_state'] else '#ff6666'}; "
                     "border: 1px solid black; font-size: 9px; font-weight: bold;"
                 )
 
                 # Power mode indicator
-                indicators['power_mode'].setStyleSheet(
+                render.set(indicators['power_mode'], "setStyleSheet",
                     f"background-color: {'#ff9933' if channel_data['power_control'] == 'INT' else '#3399ff'}; "
                     "border: 1px solid black; font-size: 8px; font-weight: bold;"
                 )
 
             # Update current channel controls if they're not being edited
-            if hasattr(self, '_current_channel'):
+            if hasattr(self, '_current_channel') and f'channel{self._current_channel}' in changed:
                 current_data = status[f'channel{self._current_channel}']
                 if not self._freq_input.hasFocus():
                     self._freq_input.setText(f"{current_data['frequency']:.1f}")
@@ -1,4 +1,8 @@
 # -*- coding: utf-8 -*-
+import copy
+import threading
+import time
+
 import numpy as np
 import scipy.optimize
 from devices import H_C, N_AIR
@@ -8,6 +12,11 @@ from devices.zeromq_device import (
     include_remote_methods,
     remote,
 )
+from devices.async_calls import AsyncOperationsMixin
+from devices.background_init import BackgroundInitMixin
+from devices.metrics import MetricsMixin
+from devices.status_delta import DeltaStatusMixin
+from devices.ui_updates import RenderCache, StatusThrottle
 from PyQt6 import QtCore, QtGui, QtWidgets
 from PyQt6.QtCore import Qt
 from PyQt6.QtGui import QColor, QCursor, QFont
@@ -34,12 +43,62 @@ from PyQt6.QtWidgets import (
 )
 
 
-class ChameleonWorker(DeviceWorker):
-    def __init__(self, port, *args, **kwargs):
+def _is_on(reply):
+    return int(reply) == 1
+
+
+class ChameleonWorker(DeltaStatusMixin, MetricsMixin, AsyncOperationsMixin, BackgroundInitMixin, DeviceWorker):
+    # (section, key, query, parser) polled by the background status thread
+    _FAST_FIELDS = [
+        ("laser", "busy", "?ST", str),
+        ("laser", "tuning", "?TS", int),
+        ("laser", "lasing", "?L", _is_on),
+        ("tunable", "power", "?PVAR", int),
+        ("fixed", "power", "?PFIXED", int),
+    ]
+    _SLOW_FIELDS = [
+        ("laser", "keyswitch", "?K", int),
+        ("tunable", "wavelength", "?VW", int),
+        ("tunable", "shutter", "?SVAR", _is_on),
+        ("tunable", "align", "?ALIGNVAR", int),
+        ("fixed", "shutter", "?SFIXED", _is_on),
+        ("fixed", "align", "?ALIGNFIXED", int),
+    ]
+
+    # ?TS can still read 0 right after WV=, so a tune only counts as done once it was seen
+    # running or this long has passed
+    _TUNE_START_GRACE = 0.3
+    _TUNE_TIMEOUT = 120.0
+
+    def __init__(self, port, *args, fast_interval=0.25, slow_interval=2.0, tune_poll_interval=0.02, **kwargs):
+        """fast_interval / slow_interval: poll periods in seconds for the fast-changing
+        (power, tuning, busy, lasing) and slow-changing (keyswitch, wavelength, shutters, align) fields
+        tune_poll_interval: ?TS poll period while a wavelength change is in progress"""
         super().__init__(*args, **kwargs)
         self.port = port
-
-    def init_device(self):
+        self._fast_interval = float(fast_interval)
+        self._slow_interval = float(slow_interval)
+        self._tune_poll_interval = float(tune_poll_interval)
+
+        # Tuning watcher; "event" counts completed tunes so subscribers can spot a new one
+        self._tune_cond = threading.Condition()
+        self._tune_generation = 0
+        self._tune = {"state": "idle", "target": None, "settle_time": None, "event": 0}
+
+        self._scan_thread = None
+        self._scan_stop = threading.Event()
+        self._scan = {"running": False, "index": 0, "total": 0, "last_step": None, "error": None}
+        self._scan_steps = []
+
+        self._io_lock = threading.Lock()
+        # Commands waiting for the port; the poller steps aside while this is non-zero
+        self._pending_commands = 0
+        self._pending_lock = threading.Lock()
+        self._status_cache = {"laser": {}, "tunable": {}, "fixed": {}}
+        self._poll_stop = threading.Event()
+        self._poll_thread = None
+
+    def _init_hardware(self):
         from pyvisa import ResourceManager
 
         rm = ResourceManager()
@@ -52,38 +111,75 @@ class ChameleonWorker(DeviceWorker):
         self.query("?L")  # would raise an exception if communication failed
         print("OK")
 
+        # Fill the cache once so the first status() is complete, then keep it fresh in the background
+        self._poll_group(self._SLOW_FIELDS + self._FAST_FIELDS)
+        self._poll_thread = threading.Thread(target=self._poll_loop, daemon=True)
+        self._poll_thread.start()
+
     def __del__(self):
+        self._poll_stop.set()
         self.ser.close()  # serial port close
 
     def status(self):
+        """Served from the cache kept by the background poller, never touches the port"""
         d = super().status()
-        d["laser"] = {
-            "keyswitch": self.keyswitch(),
-            "busy": self.busy(),
-            "tuning": self.tuning(),
-            "lasing": self.is_lasing(),
-        }
-        d["tunable"] = {
-            "wavelength": self.wavelength(),
-            "power": self.power_tunable(),
-            "shutter": self.is_shutter_open_tunable(),
-            "align": self.align_tunable(),
-        }
-        d["fixed"] = {
-            "power": self.power_fixed(),
-            "shutter": self.is_shutter_open_fixed(),
-            "align": self.align_fixed(),
-        }
-        return d
-
-    @remote
-    def query(self, command):
-        res = self.handle.query(command)
+        d.update(copy.deepcopy(self._status_cache))
+        d["tune"] = dict(self._tune)
+        d["scan"] = dict(self._scan)
+        return self._publish_status(d)
+
+    def _query_io(self, command):
+        with self._metrics.timed("query"):
+            res = self.handle.query(command)
         if not res.startswith(command):
+            self._metrics.count("echo_errors")
             raise Exception("No connection to laser or ECHO is OFF")
         res = res[len(command) :].strip()
         return res
 
+    @remote
+    def query(self, command):
+        with self._pending_lock:
+            self._pending_commands += 1
+        try:
+            waited = time.perf_counter()
+            with self._io_lock:
+                self._metrics.observe("io_lock_wait", time.perf_counter() - waited)
+                return self._query_io(command)
+        finally:
+            with self._pending_lock:
+                self._pending_commands -= 1
+
+    def _poll_group(self, fields):
+        for section, key, command, parse in fields:
+            # Commands go first; the poller only ever holds the port for a single query
+            while self._pending_commands and not self._poll_stop.is_set():
+                time.sleep(0.001)
+            with self._io_lock:
+                reply = self._query_io(command)
+            self._status_cache[section][key] = parse(reply)
+
+    def _poll_loop(self):
+        next_fast = next_slow = time.monotonic()
+        while not self._poll_stop.is_set():
+            try:
+                now = time.monotonic()
+                if now >= next_slow:
+                    self._poll_group(self._SLOW_FIELDS)
+                    next_slow = now + self._slow_interval
+                if now >= next_fast:
+                    self._poll_group(self._FAST_FIELDS)
+                    next_fast = now + self._fast_interval
+            except Exception as e:
+                self._metrics.error("poll", e)
+                print(f"Chameleon status poll failed: {e}")
+                next_fast = next_slow = time.monotonic() + self._slow_interval
+            self._poll_stop.wait(max(0.0, min(next_fast, next_slow) - time.monotonic()))
+
+    def _update_cache(self, section, key, value):
+        """Write-through after a command, so status() reflects it before the next poll"""
+        self._status_cache[section][key] = value
+
     @remote
     def wavelength(self):
         return int(self.query("?VW"))
@@ -91,17 +187,206 @@ class ChameleonWorker(DeviceWorker):
     @remote
     def set_wavelength(self, nm):
         self.query(f"WV={int(nm)}")
+        self._update_cache("tunable", "wavelength", int(nm))
+        self._start_tune_watch(int(nm))
+
+    @remote
+    def set_wavelength_and_wait(self, nm, timeout=60.0):
+        """Sets the wavelength and returns the settle time in seconds as soon as the laser reports
+        the tune complete. Returns None if another set_wavelength superseded this one."""
+        return self._set_wavelength_and_wait(nm, timeout)
+
+    def _set_wavelength_and_wait(self, nm, timeout, stop=None):
+        """stop: optional threading.Event that also ends the wait (returning None); whoever sets it
+        must notify _tune_cond"""
+        self.set_wavelength(nm)
+        with self._tune_cond:
+            generation = self._tune_generation
+            done = self._tune_cond.wait_for(
+                lambda: self._tune_generation != generation
+                or self._tune["state"] != "tuning"
+                or (stop is not None and stop.is_set()),
+                timeout,
+            )
+            if stop is not None and stop.is_set():
+                return None
+            if not done:
+                raise TimeoutError(f"Tuning to {int(nm)} nm did not finish within {timeout} s")
+            if self._tune_generation != generation:
+                return None
+            if self._tune["state"] != "complete":
+                raise TimeoutError(f"Tuning to {int(nm)} nm did not finish")
+            return self._tune["settle_time"]
+
+    def _completion_check(self, method, args, kwargs):
+        """call_async: set_wavelength completes with the settle time once the tune watcher reports
+        the laser tuned (None if another set_wavelength superseded it)"""
+        if method != "set_wavelength":
+            return None
+        generation = self._tune_generation + 1
+
+        def check():
+            with self._tune_cond:
+                if self._tune_generation != generation:
+                    return True, None
+                if self._tune["state"] == "tuning":
+                    return False, None
+                if self._tune["state"] != "complete":
+                    raise TimeoutError(f"Tuning to {self._tune['target']} nm did not finish")
+                return True, self._tune["settle_time"]
+
+        return check
+
+    @remote
+    def tune_status(self):
+        """State of the last wavelength change: idle / tuning / complete / timeout, with settle time"""
+        return dict(self._tune)
+
+    _SCAN_WAVELENGTH_MIN = 680
+    _SCAN_WAVELENGTH_MAX = 1030
+    _SHUTTER_POLICIES = ("none", "open", "gate")
+
+    @remote
+    def run_scan(self, wavelengths, dwell, shutter_policy="gate", power_interval=0.1, tune_timeout=60.0):
+        """Runs a whole wavelength scan worker-side in a background thread.
+        wavelengths: list of nm; dwell: seconds at each wavelength once tuned
+        shutter_policy: "none" leaves the tunable shutter alone, "open" opens it for the whole scan,
+                        "gate" keeps it closed while tuning and open only during each dwell
+        Progress is published in status()["scan"]; scan_results() returns every step so far."""
+        if self._scan_thread is not None and self._scan_thread.is_alive():
+            raise RuntimeError("A scan is already running")
+        if shutter_policy not in self._SHUTTER_POLICIES:
+            raise ValueError(f"Wrong shutter policy: {shutter_policy}. Expected one of {self._SHUTTER_POLICIES}")
+        wavelengths = [int(nm) for nm in wavelengths]
+        if not wavelengths:
+            raise ValueError("Empty scan")
+        if min(wavelengths) < self._SCAN_WAVELENGTH_MIN or max(wavelengths) > self._SCAN_WAVELENGTH_MAX:
+            raise ValueError(
+                f"Wavelength must be between {self._SCAN_WAVELENGTH_MIN} and {self._SCAN_WAVELENGTH_MAX} nm"
+            )
+
+        self._scan_stop.clear()
+        self._scan_steps = []
+        self._scan = {"running": True, "index": 0, "total": len(wavelengths), "last_step": None, "error": None}
+        self._scan_thread = threading.Thread(
+            target=self._scan_loop,
+            args=(wavelengths, float(dwell), shutter_policy, float(power_interval), float(tune_timeout)),
+            daemon=True,
+        )
+        self._scan_thread.start()
+        return True
+
+    def _scan_loop(self, wavelengths, dwell, policy, power_interval, tune_timeout):
+        start = time.monotonic()
+        try:
+            if policy == "open":
+                self.open_shutter_tunable()
+            for i, nm in enumerate(wavelengths):
+                if self._scan_stop.is_set():
+                    break
+                step = {"wavelength": nm, "tune_start": time.monotonic() - start}
+                if policy == "gate":
+                    self.close_shutter_tunable()
+                step["settle_time"] = self._set_wavelength_and_wait(nm, tune_timeout, self._scan_stop)
+                # Stopped while tuning: the step has no dwell and no power samples, and the shutter stays closed
+                if self._scan_stop.is_set():
+                    break
+                if step["settle_time"] is None:
+                    raise RuntimeError(f"Tuning to {nm} nm was superseded by another set_wavelength")
+                if policy == "gate":
+                    self.open_shutter_tunable()
+
+                # Power is sampled during the dwell, so the step costs no extra time afterwards
+                step["dwell_start"] = time.monotonic() - start
+                dwell_end = start + step["dwell_start"] + dwell
+                samples = []
+                while True:
+                    samples.append(int(self.query("?PVAR")))
+                    remaining = dwell_end - time.monotonic()
+                    if remaining <= 0 or self._scan_stop.is_set():
+                        break
+                    self._scan_stop.wait(min(power_interval, remaining))
+                step["dwell_end"] = time.monotonic() - start
+                step["power_mean"] = float(np.mean(samples))
+                step["power_min"] = int(np.min(samples))
+                step["power_max"] = int(np.max(samples))
+
+                self._scan_steps.append(step)
+                self._scan.update(index=i + 1, last_step=step)
+        except Exception as e:
+            self._scan["error"] = str(e)
+            print(f"Wavelength scan aborted: {e}")
+        finally:
+            if policy in ("open", "gate"):
+                try:
+                    self.close_shutter_tunable()
+                except Exception as e:
+                    print(f"Could not close the tunable shutter after the scan: {e}")
+            self._scan.update(running=False, elapsed=time.monotonic() - start)
+
+    @remote
+    def scan_results(self):
+        """Per-step timestamps (seconds from scan start), settle times and power readings"""
+        return list(self._scan_steps)
+
+    @remote
+    def stop_scan(self):
+        self._scan_stop.set()
+        with self._tune_cond:
+            self._tune_cond.notify_all()  # ends a tune wait of the scan
+        if self._scan_thread is not None:
+            self._scan_thread.join(timeout=5)
+        return dict(self._scan)
+
+    def _start_tune_watch(self, nm):
+        with self._tune_cond:
+            self._tune_generation += 1
+            generation = self._tune_generation
+            self._tune.update(state="tuning", target=nm, settle_time=None)
+            self._tune_cond.notify_all()  # waiters on an older tune see it superseded
+        threading.Thread(
+            target=self._watch_tune, args=(generation, time.monotonic()), daemon=True
+        ).start()
+
+    def _watch_tune(self, generation, start):
+        seen_tuning = False
+        state = "timeout"
+        while generation == self._tune_generation:
+            try:
+                tuning = int(self.query("?TS"))
+                self._update_cache("laser", "tuning", tuning)
+            except Exception as e:
+                print(f"Tuning watcher query failed: {e}")
+                tuning = None
+            elapsed = time.monotonic() - start
+            if tuning == 1:
+                seen_tuning = True
+            elif tuning == 0 and (seen_tuning or elapsed >= self._TUNE_START_GRACE):
+                state = "complete"
+                break
+            if elapsed >= self._TUNE_TIMEOUT:
+                break
+            time.sleep(self._tune_poll_interval)
+        else:
+            return  # superseded by a newer set_wavelength
+
+        with self._tune_cond:
+            if generation == self._tune_generation:
+                self._tune.update(state=state, settle_time=elapsed, event=self._tune["event"] + 1)
+                self._tune_cond.notify_all()
 
     @remote
     def open_shutter_tunable(self, ok=True):
         if ok:
             self.query("SVAR=1")
+            self._update_cache("tunable", "shutter", True)
         else:
             self.close_shutter_tunable()
 
     @remote
     def close_shutter_tunable(self):
         self.query("SVAR=0")
+        self._update_cache("tunable", "shutter", False)
 
     @remote
     def is_shutter_open_tunable(self):
@@ -111,12 +396,14 @@ class ChameleonWorker(DeviceWorker):
     def open_shutter_fixed(self, ok=True):
         if ok:
             self.query("SFIXED=1")
+            self._update_cache("fixed", "shutter", True)
         else:
             self.close_shutter_fixed()
 
     @remote
     def close_shutter_fixed(self):
         self.query("SFIXED=0")
+        self._update_cache("fixed", "shutter", False)
 
     @remote
     def is_shutter_open_fixed(self):
@@ -132,6 +419,7 @@ class ChameleonWorker(DeviceWorker):
             self.query("L=1")
         else:
             self.query("L=0")
+        self._update_cache("laser", "lasing", bool(state))
 
     @remote
     def power_tunable(self):
@@ -169,20 +457,28 @@ class ChameleonWorker(DeviceWorker):
     def set_align_tunable(self, state: int):
         """Sets the alignment mode status: 1-Enabled and 0-Disabled"""
         self.query(f"ALIGNVAR={state}")
+        self._update_cache("tunable", "align", int(state))
 
     @remote
     def set_align_fixed(self, state: int):
         """Sets the alignment mode status: 1-Enabled and 0-Disabled"""
         self.query(f"ALIGNFIXED={state}")
+        self._update_cache("fixed", "align", int(state))
 
 
 @include_remote_methods(ChameleonWorker)
 class Chameleon(DeviceOverZeroMQ):
-    def __init__(self, *args, **kwargs):
+    def __init__(self, *args, max_ui_rate=20.0, **kwargs):
+        """max_ui_rate: dock repaints per second at most"""
         super().__init__(*args, **kwargs)
+        self._max_ui_rate = float(max_ui_rate)
         # Default values for GUI display
         self._fixed_shutter_open = 0
         self._tunable_shutter_open = 0
+        # Status messages are merged as they arrive and rendered at most max_ui_rate times per second
+        self._status_throttle = None
+        # Widget setters skip values that are already on screen
+        self._render = RenderCache()
 
     def createDock(self, parentWidget, menu=None):
         # Create the dock widget
@@ -489,6 +785,10 @@ class Chameleon(DeviceOverZeroMQ):
         print("\t --INITIALIZING--")
         self.initial_check()
         # print(self.status())
+        self._ui_timer = QtCore.QTimer(dock)
+        self._ui_timer.setSingleShot(True)
+        self._status_throttle = StatusThrottle(self._render_status, self._ui_timer, self._max_ui_rate)
+        self._ui_timer.timeout.connect(self._status_throttle.flush)
         self.createListenerThread(self.updateSlot)
         print("\t --DONE--")
 
@@ -520,32 +820,57 @@ class Chameleon(DeviceOverZeroMQ):
             )
 
     def updateSlot(self, status):
+        """Listener slot; every message is merged, the dock is rendered at most max_ui_rate times per second"""
+        self._status_throttle.push(status)
+
+    def _render_status(self, status, changed):
         """Update UI elements based on device status updates"""
+        tunable = changed.get("tunable", {})
+        fixed = changed.get("fixed", {})
+        laser = changed.get("laser", {})
         try:
-            wl = status["tunable"]["wavelength"]
-            self.wavelength_slider.setValue(wl)
-            self.wavelength_indicator.setText(f"{wl} nm")
-
-            self.update_fixed_shutter_ui(status["fixed"]["shutter"])
-            self.update_tunable_shutter_ui(status["tunable"]["shutter"])
-            self.update_align(
-                status["laser"]["busy"],
-                status["tunable"]["align"],
-                status["fixed"]["align"],
-            )
-            self.update_state_info(status["laser"])
-
-            if status["laser"]["lasing"]:
-                self.red_rectangle.setStyleSheet(
-                    "background-color: darkred; color: white; font-weight: bold; font-size: 20px; border: 2px solid red; padding: 1px; border-radius: 10px;"
-                )
-            else:
-                self.red_rectangle.setStyleSheet(
-                    "background-color: gray; color: white; font-weight: bold; font-size: 20px; border: 2px solid darkgray; padding: 1px; border-radius: 10px;"
+            if "wavelength" in tunable:
+                wl = status["tunable"]["wavelength"]
+                self.wavelength_slider.setValue(wl)
+                self._render.set(self.wavelength_indicator, "setText", f"{wl} nm")
+
+            tune = changed.get("tune", {})
+            if "event" in tune and status["tune"]["state"] == "complete":
+                self.wavelength_indicator.setToolTip(
+                    f"Tuned to {status['tune']['target']} nm in {status['tune']['settle_time']:.2f} s"
                 )
 
-            self.left_lcd.display(status["fixed"]["power"])
-            self.right_lcd.display(status["tunable"]["power"])
+            if "shutter" in fixed:
+                self.update_fixed_shutter_ui(status["fixed"]["shutter"])
+            if "shutter" in tunable:
+                self.update_tunable_shutter_ui(status["tunable"]["shutter"])
+            if "busy" in laser or "align" in tunable or "align" in fixed:
+                self.update_align(
+                    status["laser"]["busy"],
+                    status["tunable"]["align"],
+                    status["fixed"]["align"],
+                )
+            if laser:
+                self.update_state_info(status["laser"])
+
+            if "lasing" in laser:
+                if status["laser"]["lasing"]:
+                    self._render.set(
+                        self.red_rectangle,
+                        "setStyleSheet",
+                        "background-color: darkred; color: white; font-weight: bold; font-size: 20px; border: 2px solid red; padding: 1px; border-radius: 10px;",
+                    )
+                else:
+                    self._render.set(
+                        self.red_rectangle,
+                        "setStyleSheet",
+                        "background-color: gray; color: white; font-weight: bold; font-size: 20px; border: 2px solid darkgray; padding: 1px; border-radius: 10px;",
+                    )
+
+            if "power" in fixed:
+                self._render.set(self.left_lcd, "display", status["fixed"]["power"])
+            if "power" in tunable:
+                self._render.set(self.right_lcd, "display", status["tunable"]["power"])
 
         except Exception as e:
             print(f"Error in updateSlot: {str(e)}")
@@ -554,30 +879,38 @@ class Chameleon(DeviceOverZeroMQ):
         """Update fixed shutter button appearance"""
         if s:
             self._fixed_shutter_open = 1
-            self.left_button.setText("OPEN")
-            self.left_button.setStyleSheet(
-                "color: white; font-weight: bold; font-size: 14px; background-color: green;"
+            self._render.set(self.left_button, "setText", "OPEN")
+            self._render.set(
+                self.left_button,
+                "setStyleSheet",
+                "color: white; font-weight: bold; font-size: 14px; background-color: green;",
             )
         else:
             self._fixed_shutter_open = 0
-            self.left_button.setText("CLOSED")
-            self.left_button.setStyleSheet(
-                "color: white; font-weight: bold; font-size: 14px; background-color: gray;"
+            self._render.set(self.left_button, "setText", "CLOSED")
+            self._render.set(
+                self.left_button,
+                "setStyleSheet",
+                "color: white; font-weight: bold; font-size: 14px; background-color: gray;",
             )
 
     def update_tunable_shutter_ui(self, s):
         """Update tunable shutter button appearance"""
         if s:
             self._tunable_shutter_open = 1
-            self.right_button.setText("OPEN")
-            self.right_button.setStyleSheet(
-                "color: white; font-weight: bold; font-size: 14px; background-color: green;"
+            self._render.set(self.right_button, "setText", "OPEN")
+            self._render.set(
+                self.right_button,
+                "setStyleSheet",
+                "color: white; font-weight: bold; font-size: 14px; background-color: green;",
             )
         else:
             self._tunable_shutter_open = 0
-            self.right_button.setText("CLOSED")
-            self.right_button.setStyleSheet(
-                "color: white; font-weight: bold; font-size: 14px; background-color: gray;"
+            self._render.set(self.right_button, "setText", "CLOSED")
+            self._render.set(
+                self.right_button,
+                "setStyleSheet",
+                "color: white; font-weight: bold; font-size: 14px; background-color: gray;",
             )
 
     def update_state_info(self, s):
@@ -605,52 +938,62 @@ class Chameleon(DeviceOverZeroMQ):
         }
 
         # Update keyswitch text and color
-        self.keyText.setText(dict["keyswitch"][s["keyswitch"]])
-        self.keyText.setStyleSheet(
-            f"QPushButton {{ background-color: {color_dict['keyswitch'][s['keyswitch']]}; color: black; font-weight: bold; text-align: center; }}"
+        self._render.set(self.keyText, "setText", dict["keyswitch"][s["keyswitch"]])
+        self._render.set(
+            self.keyText,
+            "setStyleSheet",
+            f"QPushButton {{ background-color: {color_dict['keyswitch'][s['keyswitch']]}; color: black; font-weight: bold; text-align: center; }}",
         )
 
         # Update busy text
-        self.busyText.setText(s["busy"])
+        self._render.set(self.busyText, "setText", s["busy"])
         # For busy text, we could set a default color or change based on specific busy messages
         if s["busy"] in ("OK", "Fixed Alignment Mode", "Variable Alignment Mode"):
-            self.busyText.setStyleSheet(
-                "QPushButton { background-color: #90EE90; color: black; font-weight: bold; text-align: center; }"
+            self._render.set(
+                self.busyText,
+                "setStyleSheet",
+                "QPushButton { background-color: #90EE90; color: black; font-weight: bold; text-align: center; }",
             )  # Light green for OK
         else:
-            self.busyText.setStyleSheet(
-                "QPushButton { background-color: #FFD700; color: black; font-weight: bold; text-align: center; }"
+            self._render.set(
+                self.busyText,
+                "setStyleSheet",
+                "QPushButton { background-color: #FFD700; color: black; font-weight: bold; text-align: center; }",
             )  # Gold for other states
 
         # Update tuning text and color
-        self.tuningText.setText(dict["tuning"][s["tuning"]])
-        self.tuningText.setStyleSheet(
-            f"QPushButton {{ background-color: {color_dict['tuning'][s['tuning']]}; color: black; font-weight: bold; text-align: center; }}"
+        self._render.set(self.tuningText, "setText", dict["tuning"][s["tuning"]])
+        self._render.set(
+            self.tuningText,
+            "setStyleSheet",
+            f"QPushButton {{ background-color: {color_dict['tuning'][s['tuning']]}; color: black; font-weight: bold; text-align: center; }}",
         )
 
         # Update lasing text and color
-        self.lasingText.setText(dict["lasing"][s["lasing"]])
-        self.lasingText.setStyleSheet(
-            f"QPushButton {{ background-color: {color_dict['lasing'][s['lasing']]}; color: black; font-weight: bold; text-align: center; }}"
+        self._render.set(self.lasingText, "setText", dict["lasing"][s["lasing"]])
+        self._render.set(
+            self.lasingText,
+            "setStyleSheet",
+            f"QPushButton {{ background-color: {color_dict['lasing'][s['lasing']]}; color: black; font-weight: bold; text-align: center; }}",
         )
 
     def update_align(self, s, ta, fa):
         """Update the alignment mode checkboxes"""
         if s == "OK" and ta == 0 and fa == 0:
-            self.checkbox_fixed.setDisabled(False)
-            self.checkbox_tunable.setDisabled(False)
+            self._render.set(self.checkbox_fixed, "setDisabled", False)
+            self._render.set(self.checkbox_tunable, "setDisabled", False)
         elif s == "Variable Alignment Mode" and ta == 1 and fa == 0:
-            self.checkbox_fixed.setDisabled(True)
-            self.checkbox_tunable.setDisabled(False)
+            self._render.set(self.checkbox_fixed, "setDisabled", True)
+            self._render.set(self.checkbox_tunable, "setDisabled", False)
         elif s == "Fixed Alignment Mode" and ta == 0 and fa == 1:
-            self.checkbox_fixed.setDisabled(False)
-            self.checkbox_tunable.setDisabled(True)
+            self._render.set(self.checkbox_fixed, "setDisabled", False)
+            self._render.set(self.checkbox_tunable, "setDisabled", True)
         else:
-            self.checkbox_fixed.setDisabled(True)
-            self.checkbox_tunable.setDisabled(True)
+            self._render.set(self.checkbox_fixed, "setDisabled", True)
+            self._render.set(self.checkbox_tunable, "setDisabled", True)
 
     def initial_check(self):
-        s = self.status()
+        s = self.full_status()
         if s["laser"]["busy"] == "Fixed Alignment Mode":
             self.checkbox_fixed.setChecked(True)
         elif s["laser"]["busy"] == "Variable Alignment Mode":
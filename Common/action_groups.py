@@ -0,0 +1,253 @@
+# -*- coding: utf-8 -*-
+"""
+Cross-device action groups executed next to the device workers
+
+Copy this file to the pylums/devices folder (next to zeromq_device.py).
+
+A measurement step such as "move the delay line, wait until it settles, then
+open shutter 4 and unblank AOM channel 2" otherwise costs one client round
+trip per call, plus client-side polling, with nothing tying the calls
+together. ActionGroupWorker runs in DeviceServer on the same host as the other
+workers and executes a whole group from one run_group() request: each action
+gets its own thread, starts as soon as the actions it lists in "after" are
+done, and calls its device over a local connection. Actions on different
+devices therefore run concurrently; calls to the same device are serialized
+on that device's connection. run_group() returns once every action finished,
+failed or the group timed out.
+
+An action is a plain dict (JSON, so it travels over the REQ socket):
+
+    {"id": "delay", "device": "4WDL", "call": "move_absolute", "args": [104351285, 12.5],
+     "until": {"call": "is_settled", "args": [104351285, 12.5], "timeout": 30}}
+    {"id": "open", "device": "ServoShutter", "call": "move_immediate", "args": ["open", 4],
+     "after": ["delay"]}
+    {"id": "unblank", "device": "mcp", "call": "configure_blanking", "args": [2],
+     "kwargs": {"blanking_on": False}, "after": ["delay"]}
+
+device is a local_devices.ini section listed in the worker's devices option.
+"until" polls call every poll seconds (default 0.01) until it returns equals
+(default: anything true), for moves that return before the motion is done.
+Poll a condition that includes the target (APTWorker.is_settled): a plain
+"stopped" check can pass before the motion has even started.
+"delay" waits that many seconds after the dependencies before the call.
+
+The result has "ok" and, per action id, "state" (done, failed, skipped because
+a dependency did not complete, or timeout), "result", "error" and the
+"start"/"end" times in seconds since the group started.
+
+local_devices.ini:
+
+    [actions]
+    name = Action Groups
+    class = action_groups.ActionGroupWorker
+    req_port = 7050
+    pub_port = 7051
+    devices = ServoShutter, mcp, 4WDL
+
+Scripts use ActionGroups(req_port=7050).run_group([...]) with action() to
+build the entries; APT.move_relative_picoseconds_action() gives the delay line
+step relative to the zero set in the GUI.
+"""
+
+import configparser
+import importlib
+import threading
+import time
+
+from devices.zeromq_device import (
+    DeviceOverZeroMQ,
+    DeviceWorker,
+    include_remote_methods,
+    remote,
+)
+from devices.metrics import MetricsMixin
+
+default_req_port = 7050
+default_pub_port = 7051
+
+
+def action(id, device, call, *args, after=(), until=None, delay=0.0, **kwargs):
+    """ Builds one entry of an action group; kwargs are passed on to the remote call """
+    entry = {"id": id, "device": device, "call": call, "args": list(args), "kwargs": kwargs}
+    if after:
+        entry["after"] = [after] if isinstance(after, str) else list(after)
+    if until is not None:
+        entry["until"] = until
+    if delay:
+        entry["delay"] = delay
+    return entry
+
+
+def _ordered(actions):
+    """ Validates the group and returns the action ids in dependency order """
+    ids = [a.get("id") for a in actions]
+    if None in ids or len(set(ids)) != len(ids):
+        raise ValueError("Every action needs a unique id")
+    after = {a["id"]: list(a.get("after", ())) for a in actions}
+    for id, deps in after.items():
+        unknown = [d for d in deps if d not in after]
+        if unknown:
+            raise ValueError(f"Action {id} waits for unknown action(s) {unknown}")
+    order = []
+    remaining = dict(after)
+    while remaining:
+        ready = [id for id, deps in remaining.items() if all(d in order for d in deps)]
+        if not ready:
+            raise ValueError(f"Circular dependencies between {sorted(remaining)}")
+        order += ready
+        for id in ready:
+            del remaining[id]
+    return order
+
+
+class ActionGroupWorker(MetricsMixin, DeviceWorker):
+    def __init__(self, req_port=default_req_port, pub_port=default_pub_port, devices="",
+                 config="local_devices.ini", host="localhost", **kwargs):
+        """ devices: comma separated local_devices.ini sections the groups may address
+            config: the local_devices.ini holding their class and ports
+            host: where those workers run """
+        super().__init__(req_port=req_port, pub_port=pub_port, **kwargs)
+        if isinstance(devices, str):
+            devices = [name.strip() for name in devices.split(",") if name.strip()]
+        self._device_names = list(devices)
+        self._config_path = config
+        self._host = host
+        self._proxies = {}
+        self._device_locks = {}
+        self._group_lock = threading.Lock()
+        self._running = 0
+        self._groups_run = 0
+        self._last_group = None
+
+    def init_device(self):
+        config = configparser.ConfigParser()
+        config.read(self._config_path)
+        for name in self._device_names:
+            if name not in config:
+                raise ValueError(f"{name} is not a section of {self._config_path}")
+            self._proxies[name] = self._make_proxy(config[name])
+            self._device_locks[name] = threading.Lock()
+        print(f"Action groups over {', '.join(self._proxies) or 'no devices'}")
+
+    def _make_proxy(self, section):
+        """ Client for a worker, with the worker's @remote methods only (no GUI code) """
+        module_name, class_name = section["class"].rsplit(".", 1)
+        worker_class = getattr(importlib.import_module("devices." + module_name), class_name)
+        proxy_class = include_remote_methods(worker_class)(type(class_name + "Proxy", (DeviceOverZeroMQ,), {}))
+        return proxy_class(req_port=int(section["req_port"]), pub_port=int(section["pub_port"]),
+                           host=section.get("host", self._host))
+
+    def status(self):
+        d = super().status()
+        d["devices"] = list(self._proxies)
+        d["running"] = self._running
+        d["groups_run"] = self._groups_run
+        d["last_group"] = self._last_group
+        return d
+
+    @remote
+    def devices(self):
+        return list(self._proxies)
+
+    @remote
+    def run_group(self, actions, timeout=60.0):
+        """ Executes the actions with their dependencies; returns once the whole group completed """
+        order = _ordered(actions)
+        by_id = {a["id"]: a for a in actions}
+        for a in actions:
+            if a.get("device") not in self._proxies:
+                raise ValueError(f"Action {a['id']}: unknown device {a.get('device')}")
+            if not a.get("call"):
+                raise ValueError(f"Action {a['id']}: no call given")
+
+        started = time.monotonic()
+        deadline = started + float(timeout)
+        results = {id: {"state": "pending", "result": None, "error": None, "start": None, "end": None}
+                   for id in order}
+        finished = {id: threading.Event() for id in order}
+        with self._group_lock:
+            self._running += 1
+        try:
+            for id in order:
+                threading.Thread(target=self._run_action,
+                                 args=(by_id[id], results, finished, started, deadline), daemon=True).start()
+            for id in order:
+                finished[id].wait(max(0.0, deadline - time.monotonic()))
+        finally:
+            with self._group_lock:
+                self._running -= 1
+                self._groups_run += 1
+
+        # Copies: actions that timed out may still be running and update their entry
+        results = {id: dict(r) for id, r in results.items()}
+        for id, result in results.items():
+            if not finished[id].is_set():
+                result["state"] = "timeout"
+        elapsed = time.monotonic() - started
+        self._metrics.observe("group", elapsed)
+        ok = all(r["state"] == "done" for r in results.values())
+        if not ok:
+            self._metrics.count("groups_failed")
+        self._last_group = {
+            "ok": ok,
+            "elapsed": elapsed,
+            "states": {id: r["state"] for id, r in results.items()},
+        }
+        return {"ok": ok, "elapsed": elapsed, "actions": results}
+
+    def _run_action(self, a, results, finished, started, deadline):
+        result = results[a["id"]]
+        try:
+            for dep in a.get("after", ()):
+                if not finished[dep].wait(max(0.0, deadline - time.monotonic())):
+                    return  # the group timed out; run_group marks this action
+                if results[dep]["state"] != "done":
+                    result["state"] = "skipped"
+                    result["error"] = f"{dep} {results[dep]['state']}"
+                    return
+            if a.get("delay"):
+                time.sleep(max(0.0, min(float(a["delay"]), deadline - time.monotonic())))
+            result["state"] = "running"
+            result["start"] = time.monotonic() - started
+            result["result"] = self._call(a["device"], a["call"], a.get("args", ()), a.get("kwargs", {}))
+            until = a.get("until")
+            if until:
+                self._wait_until(a["device"], until, deadline)
+            result["state"] = "done"
+        except Exception as e:
+            self._metrics.error(a["device"], e)
+            result["state"] = "timeout" if isinstance(e, TimeoutError) else "failed"
+            result["error"] = f"{type(e).__name__}: {e}"
+        finally:
+            if result["start"] is not None:
+                result["end"] = time.monotonic() - started
+            finished[a["id"]].set()
+
+    def _call(self, device, call, args=(), kwargs=None):
+        with self._device_locks[device]:
+            with self._metrics.timed(f"{device}.{call}"):
+                return getattr(self._proxies[device], call)(*args, **(kwargs or {}))
+
+    def _wait_until(self, device, until, deadline):
+        """ Polls until["call"] until it returns until["equals"] (or anything true) """
+        timeout = float(until.get("timeout", 30.0))
+        poll = float(until.get("poll", 0.01))
+        stop = min(deadline, time.monotonic() + timeout)
+        while True:
+            value = self._call(device, until["call"], until.get("args", ()), until.get("kwargs", {}))
+            done = value == until["equals"] if "equals" in until else bool(value)
+            if done:
+                return value
+            if time.monotonic() + poll > stop:
+                raise TimeoutError(f"{device}.{until['call']} did not report completion in time")
+            time.sleep(poll)
+
+
+@include_remote_methods(ActionGroupWorker)
+class ActionGroups(DeviceOverZeroMQ):
+    """ Script-side client; has no dock, so it needs no devices.ini entry """
+
+    def __init__(self, req_port=default_req_port, pub_port=default_pub_port, **kwargs):
+        super().__init__(req_port=req_port, pub_port=pub_port, **kwargs)
+
+    action = staticmethod(action)
@@ -0,0 +1,222 @@
+# -*- coding: utf-8 -*-
+"""
+Future-returning remote calls for long-running device operations
+
+Copy this file to the pylums/devices folder (next to zeromq_device.py).
+
+Homing, tuning the laser or a stepped servo move return long before the
+device is done, so a script either blocks in a *_and_wait call or polls
+status. Workers list AsyncOperationsMixin in their bases; call_async(method,
+*args, **kwargs) then starts the call and returns an operation id right away.
+The operation completes when the device reports the work done: workers
+implement _completion_check() for their calls that return early (homing
+done, tune complete, servo moves no longer active). Any other method runs in
+a thread and completes when it returns. Running and recently finished
+operations are published in status()["operations"], so completion reaches
+subscribers over the pub socket.
+
+Scripts wrap a proxy in AsyncCalls. Every method call returns a
+concurrent.futures.Future that resolves with the operation result, so
+operations on several devices run concurrently and are awaited together:
+
+    apt_async = AsyncCalls(apt, pub_port=7009)
+    laser_async = AsyncCalls(laser, pub_port=7539, host="10.96.1.231")
+    wait_all([apt_async.home(104351285), laser_async.set_wavelength(800)], timeout=120)
+
+asyncio code can await asyncio.wrap_future(future).
+"""
+
+import concurrent.futures
+import threading
+import time
+
+import zmq
+
+from devices.zeromq_device import remote
+from devices.status_delta import StatusMerger
+
+
+class AsyncOperationsMixin:
+    def __init__(self, *args, async_timeout=300.0, async_poll_interval=0.02, operation_history=32, **kwargs):
+        """ async_timeout: seconds after which an unfinished operation fails
+            async_poll_interval: seconds between completion checks
+            operation_history: finished operations kept in status() """
+        super().__init__(*args, **kwargs)
+        self._async_timeout = float(async_timeout)
+        self._async_poll_interval = float(async_poll_interval)
+        self._operation_history = int(operation_history)
+        self._operations = {}
+        self._operation_checks = {}
+        self._operations_lock = threading.Lock()
+        self._next_operation = 0
+        self._watcher = None
+
+    def _completion_check(self, method, args, kwargs):
+        """ Called just before method(*args, **kwargs) runs. Returns check() -> (done, result) for calls
+            that return before the device finished (check may raise to fail the operation), or None """
+        return None
+
+    def status(self):
+        d = super().status()
+        with self._operations_lock:
+            d["operations"] = {op_id: dict(op) for op_id, op in self._operations.items()}
+        return d
+
+    @remote
+    def call_async(self, method, *args, **kwargs):
+        """ Starts method(*args, **kwargs) and returns the id of the operation published in status() """
+        func = getattr(self, method, None)
+        if method.startswith("_") or method == "call_async" or not callable(func):
+            raise ValueError(f"{type(self).__name__} has no method {method}")
+        check = self._completion_check(method, args, kwargs)
+        op_id = self._begin_operation(method)
+        if check is None:
+            threading.Thread(target=self._run_operation, args=(op_id, func, args, kwargs), daemon=True).start()
+            return op_id
+        try:
+            func(*args, **kwargs)
+        except Exception as e:
+            self._finish_operation(op_id, error=e)
+            raise
+        with self._operations_lock:
+            self._operation_checks[op_id] = check
+            if self._watcher is None or not self._watcher.is_alive():
+                self._watcher = threading.Thread(target=self._watch_operations, daemon=True)
+                self._watcher.start()
+        return op_id
+
+    @remote
+    def operation_status(self, op_id):
+        with self._operations_lock:
+            op = self._operations.get(op_id)
+            return None if op is None else dict(op)
+
+    def _begin_operation(self, method):
+        with self._operations_lock:
+            self._next_operation += 1
+            op_id = str(self._next_operation)
+            self._operations[op_id] = {
+                "method": method,
+                "state": "running",
+                "result": None,
+                "error": None,
+                "started": time.time(),
+                "elapsed": None,
+            }
+            return op_id
+
+    def _finish_operation(self, op_id, result=None, error=None):
+        with self._operations_lock:
+            self._operation_checks.pop(op_id, None)
+            op = self._operations.get(op_id)
+            if op is None or op["state"] != "running":
+                return
+            op["elapsed"] = time.time() - op["started"]
+            if error is None:
+                op.update(state="done", result=result)
+            else:
+                op.update(state="failed", error=f"{type(error).__name__}: {error}")
+            finished = [k for k, o in self._operations.items() if o["state"] != "running"]
+            for k in finished[: max(0, len(finished) - self._operation_history)]:
+                del self._operations[k]
+
+    def _run_operation(self, op_id, func, args, kwargs):
+        try:
+            result = func(*args, **kwargs)
+        except Exception as e:
+            self._finish_operation(op_id, error=e)
+        else:
+            self._finish_operation(op_id, result=result)
+
+    def _watch_operations(self):
+        while True:
+            with self._operations_lock:
+                checks = [(op_id, check, self._operations[op_id]["started"])
+                          for op_id, check in self._operation_checks.items()]
+                if not checks:
+                    self._watcher = None
+                    return
+            now = time.time()
+            for op_id, check, started in checks:
+                try:
+                    done, result = check()
+                except Exception as e:
+                    self._finish_operation(op_id, error=e)
+                    continue
+                if done:
+                    self._finish_operation(op_id, result=result)
+                elif now - started > self._async_timeout:
+                    self._finish_operation(op_id, error=TimeoutError(f"not done after {self._async_timeout} s"))
+            time.sleep(self._async_poll_interval)
+
+
+class AsyncCalls:
+    """ Script-side async mode of a DeviceOverZeroMQ proxy: proxy methods called through it
+        return futures resolved from the operations published on the device's pub port """
+
+    def __init__(self, proxy, pub_port, host="localhost"):
+        self._proxy = proxy
+        self._futures = {}
+        self._lock = threading.Lock()
+        self._stop = threading.Event()
+        self._subscribed = threading.Event()
+        self._thread = threading.Thread(target=self._listen, args=(host, int(pub_port)), daemon=True)
+        self._thread.start()
+        self._subscribed.wait(1.0)
+
+    def __getattr__(self, method):
+        if method.startswith("_"):
+            raise AttributeError(method)
+        return lambda *args, **kwargs: self.call(method, *args, **kwargs)
+
+    def call(self, method, *args, **kwargs):
+        future = concurrent.futures.Future()
+        future.set_running_or_notify_cancel()
+        # Registered under the lock, so a completion published right away is not missed
+        with self._lock:
+            op_id = self._proxy.call_async(method, *args, **kwargs)
+            self._futures[op_id] = future
+        return future
+
+    def close(self):
+        self._stop.set()
+        self._thread.join()
+
+    def _listen(self, host, port):
+        socket = zmq.Context.instance().socket(zmq.SUB)
+        socket.setsockopt(zmq.SUBSCRIBE, b"")
+        socket.connect(f"tcp://{host}:{port}")
+        self._subscribed.set()
+        merger = StatusMerger()
+        try:
+            while not self._stop.is_set():
+                if not socket.poll(200):
+                    continue
+                status, changed = merger.merge(socket.recv_json())
+                if status is None or "operations" not in changed:
+                    continue
+                self._resolve(status["operations"])
+        except Exception as e:
+            print(f"Async call listener stopped: {e}")
+        finally:
+            socket.close(linger=0)
+
+    def _resolve(self, operations):
+        with self._lock:
+            for op_id, op in operations.items():
+                future = self._futures.get(op_id)
+                if future is None or op["state"] == "running":
+                    continue
+                del self._futures[op_id]
+                if op["state"] == "done":
+                    future.set_result(op["result"])
+                else:
+                    future.set_exception(RuntimeError(op["error"]))
+
+
+def wait_all(futures, timeout=None):
+    """ Results of all futures in order; raises the first failure or TimeoutError """
+    done, pending = concurrent.futures.wait(futures, timeout)
+    if pending:
+        raise TimeoutError(f"{len(pending)} operation(s) still running")
+    return [future.result() for future in futures]
@@ -0,0 +1,83 @@
+# -*- coding: utf-8 -*-
+"""
+Non-blocking device bring-up shared by the device workers
+
+Copy this file to the pylums/devices folder (next to zeromq_device.py).
+
+DeviceServer brings the autostart workers up one after another, and each
+init_device() blocks on its hardware (opening ports, handshakes, VISA
+resources, motor enumeration). Workers list BackgroundInitMixin in their bases
+and implement _init_hardware() instead of init_device(). With
+background_init = true in the device's local_devices.ini entry, init_device()
+returns at once and _init_hardware() runs in its own thread, so all devices
+come up concurrently and a slow or missing one no longer holds up the rest.
+
+status()["init"] reports readiness: state is "initializing", "ready",
+"failed" (with the error) or "timeout" once init_timeout seconds pass without
+the device coming up (the thread keeps trying and may still turn "ready").
+Scripts can block on wait_ready().
+"""
+
+import threading
+import time
+
+from devices.zeromq_device import remote
+
+
+class BackgroundInitMixin:
+    def __init__(self, *args, background_init=False, init_timeout=30.0, **kwargs):
+        """ background_init: run _init_hardware() in a thread instead of blocking init_device()
+            init_timeout: seconds after which a still running initialization is reported as "timeout" """
+        super().__init__(*args, **kwargs)
+        self._background_init = background_init in (True, "true", "True", "1", 1)
+        self._init_timeout = float(init_timeout)
+        self._init_done = threading.Event()
+        self._init_info = {"state": "initializing", "error": None, "elapsed": None}
+        self._init_started = None
+
+    def _init_hardware(self):
+        raise NotImplementedError
+
+    def init_device(self):
+        self._init_started = time.monotonic()
+        if not self._background_init:
+            self._run_init(raise_errors=True)
+            return
+        threading.Thread(target=self._run_init, daemon=True).start()
+
+    def _run_init(self, raise_errors=False):
+        try:
+            self._init_hardware()
+            self._init_info.update(state="ready")
+        except Exception as e:
+            self._init_info.update(state="failed", error=str(e))
+            print(f"{type(self).__name__}: initialization failed: {e}")
+            if raise_errors:
+                raise
+        finally:
+            self._init_info["elapsed"] = time.monotonic() - self._init_started
+            self._init_done.set()
+
+    def _device_ready(self):
+        return self._init_info["state"] == "ready"
+
+    def _init_status(self):
+        info = dict(self._init_info)
+        if (
+            info["state"] == "initializing"
+            and self._init_started is not None
+            and time.monotonic() - self._init_started > self._init_timeout
+        ):
+            info["state"] = "timeout"
+        return info
+
+    def status(self):
+        d = super().status()
+        d["init"] = self._init_status()
+        return d
+
+    @remote
+    def wait_ready(self, timeout=None):
+        """ Blocks until initialization finished (or timeout seconds); returns the init state """
+        self._init_done.wait(self._init_timeout if timeout is None else timeout)
+        return self._init_status()
@@ -0,0 +1,130 @@
+# -*- coding: utf-8 -*-
+"""
+Hot-path timing counters shared by the device workers
+
+Copy this file to the pylums/devices folder (next to zeromq_device.py).
+
+Workers list MetricsMixin in their bases and time their I/O through
+self._metrics: observe()/timed() feed a per-operation histogram with
+power-of-two microsecond buckets, count() bumps a counter and error() counts
+a failure and keeps its message. Recording is a dict lookup and a few adds
+under a lock, cheap enough for every serial transaction.
+
+get_metrics() returns the snapshot and reset_metrics() clears it; both are
+remote. The snapshot changes with every transaction, so publishing it would
+defeat the delta publishing of status(); set metrics = true in the device
+config to include it in status()["metrics"] anyway.
+"""
+
+import contextlib
+import threading
+import time
+
+from devices.zeromq_device import remote
+
+# Bucket i counts samples below 2**i microseconds; the last one takes everything longer (~8 s)
+HISTOGRAM_BUCKETS = 24
+
+
+class OperationMetrics:
+    """ Thread-safe counters and latency histograms, keyed by operation name """
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self.reset()
+
+    def reset(self):
+        with self._lock:
+            self._counters = {}
+            self._timings = {}
+            self._last_errors = {}
+
+    def count(self, name, n=1):
+        with self._lock:
+            self._counters[name] = self._counters.get(name, 0) + n
+
+    def observe(self, name, seconds):
+        us = max(seconds * 1e6, 0.0)
+        bucket = min(int(us).bit_length(), HISTOGRAM_BUCKETS - 1)
+        with self._lock:
+            t = self._timings.get(name)
+            if t is None:
+                t = self._timings[name] = {"count": 0, "total": 0.0, "max": 0.0, "hist": [0] * HISTOGRAM_BUCKETS}
+            t["count"] += 1
+            t["total"] += us
+            if us > t["max"]:
+                t["max"] = us
+            t["hist"][bucket] += 1
+
+    @contextlib.contextmanager
+    def timed(self, name):
+        start = time.perf_counter()
+        try:
+            yield
+        finally:
+            self.observe(name, time.perf_counter() - start)
+
+    def error(self, name, exc):
+        """ Counts a failure as <name>_errors and remembers the latest message """
+        with self._lock:
+            key = f"{name}_errors"
+            self._counters[key] = self._counters.get(key, 0) + 1
+            self._last_errors[name] = f"{type(exc).__name__}: {exc}"
+
+    @staticmethod
+    def _percentile(t, p):
+        """ Upper edge of the bucket holding the p-th percentile, capped at the observed max """
+        target = t["count"] * p / 100.0
+        seen = 0
+        for i, n in enumerate(t["hist"]):
+            seen += n
+            if seen >= target and n:
+                return min(float(2 ** i), t["max"])
+        return t["max"]
+
+    def snapshot(self):
+        with self._lock:
+            timings = {}
+            for name, t in self._timings.items():
+                hist = list(t["hist"])
+                while hist and not hist[-1]:
+                    hist.pop()
+                timings[name] = {
+                    "count": t["count"],
+                    "mean_us": round(t["total"] / t["count"], 1),
+                    "p50_us": round(self._percentile(t, 50), 1),
+                    "p99_us": round(self._percentile(t, 99), 1),
+                    "max_us": round(t["max"], 1),
+                    "hist": hist,
+                }
+            return {
+                "counters": dict(self._counters),
+                "timings": timings,
+                "last_errors": dict(self._last_errors),
+            }
+
+
+class MetricsMixin:
+    def __init__(self, *args, metrics=False, **kwargs):
+        """ metrics: also publish the timing snapshot in status() """
+        super().__init__(*args, **kwargs)
+        self._publish_metrics = metrics in (True, "true", "True", "1", 1)
+        self._metrics = OperationMetrics()
+
+    def status(self):
+        d = super().status()
+        if self._publish_metrics:
+            d["metrics"] = self._metrics_snapshot()
+        return d
+
+    def _metrics_snapshot(self):
+        return self._metrics.snapshot()
+
+    @remote
+    def get_metrics(self):
+        """ Counters and latency histograms of the worker's I/O paths """
+        return self._metrics_snapshot()
+
+    @remote
+    def reset_metrics(self):
+        self._metrics.reset()
@@ -0,0 +1,128 @@
+# -*- coding: utf-8 -*-
+"""
+Change-only status publication shared by the device workers and their GUIs
+
+Copy this file to the pylums/devices folder (next to zeromq_device.py).
+
+Worker side: list DeltaStatusMixin before DeviceWorker in the bases and pass
+every status() result through self._publish_status(d). With delta_status=true
+in the device config, status() then returns a full "keyframe" every
+keyframe_interval calls and, in between, only the keys that differ from that
+keyframe. Deltas are taken against the keyframe rather than the previous
+message, so extra status() calls (remote or from the publisher) can never
+make a subscriber miss a change. full_status() always returns everything.
+
+GUI side: feed each received message through StatusMerger.merge() to get the
+reconstructed status plus the keys that changed since the last message, so
+update handlers only touch the affected widgets. This also works when the
+worker publishes full snapshots.
+"""
+
+import copy
+
+from devices.zeromq_device import remote
+
+KEYFRAME_KEY = "_keyframe"
+DELTA_KEY = "_delta"
+REMOVED_KEY = "_removed"
+
+
+def diff_status(old, new):
+    """ Returns the part of new that differs from old, recursing into nested dicts """
+    changed = {}
+    for key, value in new.items():
+        if key not in old:
+            changed[key] = value
+        elif isinstance(value, dict) and isinstance(old[key], dict):
+            sub = diff_status(old[key], value)
+            if sub:
+                changed[key] = sub
+        elif value != old[key]:
+            changed[key] = value
+    return changed
+
+
+def apply_delta(base, delta):
+    """ Returns a copy of base with delta merged in (nested dicts are merged, not replaced) """
+    merged = dict(base)
+    for key, value in delta.items():
+        if isinstance(value, dict) and isinstance(merged.get(key), dict):
+            merged[key] = apply_delta(merged[key], value)
+        else:
+            merged[key] = value
+    return merged
+
+
+class DeltaStatusMixin:
+    def __init__(self, *args, delta_status=False, keyframe_interval=20, **kwargs):
+        """ delta_status: publish change-only status messages
+            keyframe_interval: status() calls between full snapshots """
+        super().__init__(*args, **kwargs)
+        self._delta_status = delta_status in (True, "true", "True", "1", 1)
+        self._keyframe_interval = max(int(keyframe_interval), 1)
+        self._keyframe = None
+        self._keyframe_id = 0
+        self._since_keyframe = 0
+        self._delta_bypass = False
+
+    def _publish_status(self, d):
+        if not self._delta_status or self._delta_bypass:
+            return d
+
+        self._since_keyframe += 1
+        if self._keyframe is None or self._since_keyframe >= self._keyframe_interval:
+            self._keyframe = copy.deepcopy(d)
+            self._keyframe_id += 1
+            self._since_keyframe = 0
+            return dict(d, **{KEYFRAME_KEY: self._keyframe_id})
+
+        delta = diff_status(self._keyframe, d)
+        removed = [key for key in self._keyframe if key not in d]
+        if removed:
+            delta[REMOVED_KEY] = removed
+        delta[DELTA_KEY] = self._keyframe_id
+        return delta
+
+    @remote
+    def full_status(self):
+        """ Complete status regardless of delta publishing """
+        self._delta_bypass = True
+        try:
+            return self.status()
+        finally:
+            self._delta_bypass = False
+
+
+class StatusMerger:
+    """ Rebuilds full status from keyframe/delta messages on the subscriber side """
+
+    def __init__(self):
+        self.status = None
+        self._keyframe = None
+        self._keyframe_id = None
+
+    def merge(self, message):
+        """ Returns (status, changed): the full status and the keys that changed since the
+            previous message. Both are None while waiting for the first keyframe. """
+        if DELTA_KEY in message:
+            if message[DELTA_KEY] != self._keyframe_id:
+                return None, None  # joined mid-stream, wait for the next keyframe
+            delta = {key: value for key, value in message.items() if key not in (DELTA_KEY, REMOVED_KEY)}
+            status = apply_delta(self._keyframe, delta)
+            for key in message.get(REMOVED_KEY, ()):
+                status.pop(key, None)
+        else:
+            status = {key: value for key, value in message.items() if key != KEYFRAME_KEY}
+            if KEYFRAME_KEY in message:
+                self._keyframe = status
+                self._keyframe_id = message[KEYFRAME_KEY]
+
+        if self.status is None:
+            changed = status
+        else:
+            changed = diff_status(self.status, status)
+            for key in self.status:
+                if key not in status:
+                    changed[key] = None
+        self.status = status
+        return status, changed
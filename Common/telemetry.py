@@ -0,0 +1,357 @@
+# -*- coding: utf-8 -*-
+"""
+Binary telemetry recorder for the device status streams
+
+Copy this file to the pylums/devices folder (next to zeromq_device.py).
+
+TelemetryRecorder subscribes to the pub ports of the devices listed in
+devices.ini and records a fixed set of fields per device (shutter states, AOM
+power, laser wavelength/power, delay line positions) with the host receive
+time. Delta-published status is rebuilt with StatusMerger first.
+
+Each device gets a folder holding schema.json and one append-only raw file
+per column (<column>.bin, native numpy dtype), so a recording is read back
+with np.memmap without parsing anything:
+
+    rec = load_recording("D:/telemetry/ServoShutter")
+    rec["t"], rec["open1"]                   # read-only memmaps, equal length
+    sample(rec, "position1", camera_times)   # value in effect at each frame
+
+The schema is fixed when a device's folder is created (from its first full
+status) and checked when a later run appends to it. Missing values are NaN for
+float columns and -1 for flags. The latest ring_size records per device are
+also kept in RAM (TelemetryRecorder.latest()) for live plots.
+
+Command line, from the pylums folder:
+
+    python -m devices.telemetry devices.ini D:/telemetry [--devices ServoShutter chameleon]
+"""
+
+import argparse
+import configparser
+import json
+import os
+import re
+import threading
+import time
+
+import numpy as np
+import zmq
+
+from devices.status_delta import StatusMerger
+
+SCHEMA_FILE = "schema.json"
+SCHEMA_VERSION = 1
+FLAG_MISSING = -1
+
+
+def _flag(value):
+    return FLAG_MISSING if value is None else int(bool(value))
+
+
+def _number(value):
+    try:
+        return float(value)
+    except (TypeError, ValueError):
+        return float("nan")
+
+
+def _get(status, path):
+    for key in path:
+        if not isinstance(status, dict):
+            return None
+        status = status.get(key)
+    return status
+
+
+# Schema builders: the first full status -> [(column, dtype, path into status)]
+
+def shutter_columns(status):
+    pins = sorted(int(key[4:]) for key in status if re.fullmatch(r"open\d+", key))
+    columns = []
+    for pin in pins:
+        columns += [
+            (f"open{pin}", "i1", (f"open{pin}",)),
+            (f"position{pin}", "f4", (f"position{pin}",)),
+            (f"moving{pin}", "i1", (f"moving{pin}",)),
+        ]
+    return columns
+
+
+def aom_columns(status):
+    columns = []
+    for ch in range(1, 5):
+        prefix = f"channel{ch}"
+        columns += [
+            (f"{prefix}.frequency", "f4", (prefix, "frequency")),
+            (f"{prefix}.power", "f4", (prefix, "power")),
+            (f"{prefix}.power_state", "i1", (prefix, "power_state")),
+            (f"{prefix}.blanking_state", "i1", (prefix, "blanking_state")),
+        ]
+    return columns
+
+
+def chameleon_columns(status):
+    return [
+        ("tunable.wavelength", "f4", ("tunable", "wavelength")),
+        ("tunable.power", "f4", ("tunable", "power")),
+        ("tunable.shutter", "i1", ("tunable", "shutter")),
+        ("fixed.power", "f4", ("fixed", "power")),
+        ("fixed.shutter", "i1", ("fixed", "shutter")),
+        ("laser.lasing", "i1", ("laser", "lasing")),
+        ("laser.tuning", "i1", ("laser", "tuning")),
+    ]
+
+
+def apt_columns(status):
+    columns = []
+    for key in sorted(k for k in status if re.fullmatch(r"apt_\d+", k)):
+        # Delay stages need sub-micrometre resolution over hundreds of mm
+        columns += [
+            (f"{key}.position", "f8", (key, "position")),
+            (f"{key}.stopped", "i1", (key, "stopped")),
+        ]
+    return columns
+
+
+# Matched against the last part of the device class in devices.ini
+SCHEMAS = {
+    "Shutter": shutter_columns,
+    "QuadAOM": aom_columns,
+    "Chameleon": chameleon_columns,
+    "APT": apt_columns,
+}
+
+
+class Ring:
+    """ Fixed-size in-RAM history of the latest records """
+
+    def __init__(self, dtype, size):
+        self._data = np.zeros(size, dtype=dtype)
+        self._size = size
+        self._count = 0
+        self._lock = threading.Lock()
+
+    def append(self, record):
+        with self._lock:
+            self._data[self._count % self._size] = record
+            self._count += 1
+
+    def latest(self, n=None):
+        """ Copy of the last n records (all buffered ones by default), oldest first """
+        with self._lock:
+            available = min(self._count, self._size)
+            n = available if n is None else min(n, available)
+            end = self._count % self._size
+            idx = np.arange(end - n, end) % self._size
+            return self._data[idx].copy()
+
+
+class DeviceRecording:
+    """ Column files of one device, opened for appending """
+
+    def __init__(self, folder, device, columns, ring_size, flush_interval):
+        self.folder = folder
+        self.columns = [("t", "f8", None)] + list(columns)
+        self.dtype = np.dtype([(name, dtype) for name, dtype, path in self.columns])
+        self._flush_interval = flush_interval
+        self._pending = []
+        self._last_flush = time.monotonic()
+        self.ring = Ring(self.dtype, ring_size)
+        self.records = 0
+
+        os.makedirs(folder, exist_ok=True)
+        schema = {
+            "version": SCHEMA_VERSION,
+            "device": device,
+            "columns": [[name, dtype] for name, dtype, path in self.columns],
+        }
+        schema_path = os.path.join(folder, SCHEMA_FILE)
+        if os.path.exists(schema_path):
+            with open(schema_path) as f:
+                existing = json.load(f)
+            if existing["columns"] != schema["columns"]:
+                raise ValueError(f"{folder} holds a recording with different columns; record to another folder")
+            self._trim_partial_records()
+        else:
+            with open(schema_path, "w") as f:
+                json.dump(schema, f, indent=1)
+        self._files = {name: open(self._column_path(name), "ab") for name, dtype, path in self.columns}
+
+    def _column_path(self, name):
+        return os.path.join(self.folder, name + ".bin")
+
+    def _trim_partial_records(self):
+        """ A crash can leave columns of unequal length; cut them back to the shortest """
+        paths = [(self._column_path(name), np.dtype(dtype).itemsize) for name, dtype, path in self.columns]
+        length = min(os.path.getsize(p) // size if os.path.exists(p) else 0 for p, size in paths)
+        for p, size in paths:
+            if os.path.exists(p):
+                os.truncate(p, length * size)
+
+    def append(self, t, status):
+        record = (t,) + tuple(
+            _flag(_get(status, path)) if dtype == "i1" else _number(_get(status, path))
+            for name, dtype, path in self.columns[1:]
+        )
+        self.ring.append(record)
+        self._pending.append(record)
+        self.records += 1
+        self.flush_if_due()
+
+    def flush_if_due(self):
+        if time.monotonic() - self._last_flush >= self._flush_interval:
+            self.flush()
+
+    def flush(self):
+        if self._pending:
+            block = np.array(self._pending, dtype=self.dtype)
+            self._pending = []
+            # Column by column; readers only trust the length all columns have reached
+            for name, f in self._files.items():
+                np.ascontiguousarray(block[name]).tofile(f)
+                f.flush()
+        self._last_flush = time.monotonic()
+
+    def close(self):
+        self.flush()
+        for f in self._files.values():
+            f.close()
+
+
+class TelemetryRecorder:
+    def __init__(self, root, devices, ring_size=10000, flush_interval=1.0):
+        """ root: folder holding one sub-folder per device
+            devices: {name: (host, pub_port, schema)} with schema a key of SCHEMAS
+            ring_size: records per device kept in RAM for live plots
+            flush_interval: seconds between writes to disk """
+        self._root = root
+        self._devices = devices
+        self._ring_size = int(ring_size)
+        self._flush_interval = float(flush_interval)
+        self._recordings = {}
+        self._threads = []
+        self._stop = threading.Event()
+        self._context = zmq.Context.instance()
+
+    @classmethod
+    def from_ini(cls, ini_path, root, names=None, **kwargs):
+        """ Records every enabled device of devices.ini whose class has a schema """
+        config = configparser.ConfigParser()
+        config.read(ini_path)
+        devices = {}
+        for name in config.sections():
+            section = config[name]
+            if names is not None and name not in names:
+                continue
+            if names is None and section.get("enabled", "true").lower() != "true":
+                continue
+            kind = section.get("class", "").rsplit(".", 1)[-1]
+            if kind not in SCHEMAS or "pub_port" not in section:
+                continue
+            devices[name] = (section.get("host", "localhost"), int(section["pub_port"]), kind)
+        return cls(root, devices, **kwargs)
+
+    def start(self):
+        for name, (host, port, schema) in self._devices.items():
+            thread = threading.Thread(target=self._listen, args=(name, host, port, schema), daemon=True)
+            thread.start()
+            self._threads.append(thread)
+
+    def stop(self):
+        self._stop.set()
+        for thread in self._threads:
+            thread.join()
+        for recording in self._recordings.values():
+            recording.close()
+
+    def latest(self, device, n=None):
+        """ Last n records of device from the RAM ring (structured array, oldest first) """
+        recording = self._recordings.get(device)
+        return None if recording is None else recording.ring.latest(n)
+
+    def counts(self):
+        return {name: recording.records for name, recording in self._recordings.items()}
+
+    def _listen(self, name, host, port, schema):
+        socket = self._context.socket(zmq.SUB)
+        socket.setsockopt(zmq.SUBSCRIBE, b"")
+        socket.connect(f"tcp://{host}:{port}")
+        merger = StatusMerger()
+        try:
+            while not self._stop.is_set():
+                if not socket.poll(200):
+                    # Quiet stream: still get the tail of the data onto disk
+                    if name in self._recordings:
+                        self._recordings[name].flush_if_due()
+                    continue
+                message = socket.recv_json()
+                t = time.time()
+                status, changed = merger.merge(message)
+                if status is None:
+                    continue  # waiting for the first keyframe
+                recording = self._recordings.get(name)
+                if recording is None:
+                    recording = DeviceRecording(os.path.join(self._root, name), name, SCHEMAS[schema](status),
+                                                self._ring_size, self._flush_interval)
+                    self._recordings[name] = recording
+                recording.append(t, status)
+        except Exception as e:
+            print(f"Telemetry for {name} stopped: {e}")
+        finally:
+            socket.close(linger=0)
+
+
+def load_recording(folder):
+    """ {column: read-only np.memmap} for a device folder, all cut to the length every column reached """
+    with open(os.path.join(folder, SCHEMA_FILE)) as f:
+        schema = json.load(f)
+    columns = []
+    for name, dtype in schema["columns"]:
+        path = os.path.join(folder, name + ".bin")
+        size = os.path.getsize(path) if os.path.exists(path) else 0
+        columns.append((name, np.dtype(dtype), path, size // np.dtype(dtype).itemsize))
+    length = min(n for name, dtype, path, n in columns)
+    recording = {}
+    for name, dtype, path, n in columns:
+        if length == 0:
+            recording[name] = np.empty(0, dtype=dtype)
+        else:
+            recording[name] = np.memmap(path, dtype=dtype, mode="r", shape=(length,))
+    return recording
+
+
+def sample(recording, column, times):
+    """ Value of column in effect at each of times (the last record at or before it); NaN before the first """
+    values = np.asarray(recording[column], dtype=float)
+    times = np.asarray(times, dtype=float)
+    idx = np.searchsorted(recording["t"], times, side="right") - 1
+    result = np.full(times.shape, np.nan)
+    valid = idx >= 0
+    result[valid] = values[idx[valid]]
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Record device status streams to memmap-able column files")
+    parser.add_argument("ini", help="devices.ini with the pub ports")
+    parser.add_argument("root", help="output folder")
+    parser.add_argument("--devices", nargs="+", help="sections to record (default: all enabled ones)")
+    parser.add_argument("--flush-interval", type=float, default=1.0)
+    args = parser.parse_args()
+
+    recorder = TelemetryRecorder.from_ini(args.ini, args.root, args.devices, flush_interval=args.flush_interval)
+    print(f"Recording {', '.join(recorder._devices) or 'nothing'} to {args.root}, Ctrl+C to stop")
+    recorder.start()
+    try:
+        while True:
+            time.sleep(5)
+            print(", ".join(f"{name}: {n}" for name, n in recorder.counts().items()))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        recorder.stop()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,87 @@
+# -*- coding: utf-8 -*-
+"""
+Rate-limited, change-only widget updates for the device docks
+
+Copy this file to the pylums/devices folder (next to zeromq_device.py).
+
+The listener thread hands every status message to the dock's update slot.
+When rendering is slower than the publish rate those calls queue up in the
+GUI event loop and each one repaints the whole dock. StatusThrottle makes the
+slot cheap: every message is only merged (StatusMerger, so no delta is ever
+lost) and the dock renders the latest state at most max_rate times per second,
+with the union of keys that changed since its last render. A backlog of
+messages therefore collapses into a single repaint.
+
+RenderCache remembers what each widget was last given and skips setters whose
+value did not change. setStyleSheet in particular makes Qt re-polish the
+widget even for an identical string, so this keeps unchanged indicators from
+repainting at all.
+
+Toolkit independent: the dock passes in a single-shot QTimer (PyQt5 or PyQt6)
+whose timeout is connected to StatusThrottle.flush.
+"""
+
+import time
+
+from devices.status_delta import StatusMerger, apply_delta
+
+
+class StatusThrottle:
+    def __init__(self, render, timer, max_rate=20.0):
+        """ render: called as render(status, changed) from the GUI thread
+            timer: single-shot QTimer with timeout connected to flush()
+            max_rate: renders per second at most """
+        self._render = render
+        self._timer = timer
+        self._min_interval = 1.0 / float(max_rate)
+        self._merger = StatusMerger()
+        self._status = None
+        self._changed = {}
+        self._last_render = 0.0
+
+    def push(self, message):
+        """ Listener slot: merge the message, render now or schedule the next render """
+        status, changed = self._merger.merge(message)
+        if not changed:
+            return
+        self._status = status
+        self._changed = apply_delta(self._changed, changed)
+        wait = self._last_render + self._min_interval - time.monotonic()
+        if wait <= 0:
+            self.flush()
+        elif not self._timer.isActive():
+            self._timer.start(int(wait * 1000) + 1)
+
+    def flush(self):
+        if not self._changed:
+            return
+        status, changed = self._status, self._changed
+        self._changed = {}
+        self._last_render = time.monotonic()
+        self._render(status, changed)
+
+
+class RenderCache:
+    """ Calls widget setters only when the value differs from the last one rendered """
+
+    _MISSING = object()
+
+    def __init__(self):
+        self._last = {}
+
+    def set(self, widget, setter, value):
+        """ widget.<setter>(value) unless that exact value was the last one set; returns True if applied """
+        key = (widget, setter)
+        if self._last.get(key, self._MISSING) == value:
+            return False
+        getattr(widget, setter)(value)
+        self._last[key] = value
+        return True
+
+    def forget(self, widget=None):
+        """ Drop the cache (for one widget), e.g. after it was changed outside the cache """
+        if widget is None:
+            self._last.clear()
+        else:
+            for key in [key for key in self._last if key[0] is widget]:
+                del self._last[key]
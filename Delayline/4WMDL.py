@@ -10,6 +10,8 @@ from devices.zeromq_device import (
     DeviceOverZeroMQ,
     include_remote_methods,
 )
+from devices.status_delta import StatusMerger
+from devices.action_groups import action
 
 default_req_port = 7008
 default_pub_port = 7009
@@ -28,6 +30,7 @@ class APT(DeviceOverZeroMQ):
         # custom initialization here
         self.widgets = {}
         self.zero_positions = {}  # Store custom zero positions for each motor
+        self._status_merger = StatusMerger()
         self.hardcoded_delaylines = [104351285, 104351286, 104351287]  # Replace with your actual IDs
 
         try:
@@ -197,6 +200,7 @@ class APT(DeviceOverZeroMQ):
         current_pos = self.get_position(serial)
         self.zero_positions[serial] = current_pos
         self.update_zero_display(serial)
+        self.update_delay_display(serial, current_pos)
 
     def update_zero_display(self, serial):
         """Update the zero position display"""
@@ -221,16 +225,66 @@ class APT(DeviceOverZeroMQ):
 
         self.move_absolute(serial, target_position)
 
+    def move_relative_picoseconds_action(
+        self, id, serial, picoseconds, device="4WDL", tolerance=0.001, settle_timeout=30.0, **options
+    ):
+        """Action group entry (see devices.action_groups) moving to picoseconds relative to the set
+        zero and completing once the stage settled within tolerance (mm) of the target; device is
+        the worker's local_devices.ini section"""
+        target_position = self._zero_for_scan(serial) + self.picoseconds_to_mm(picoseconds)
+        until = {"call": "is_settled", "args": [serial, target_position, tolerance], "timeout": settle_timeout}
+        return action(id, device, "move_absolute", serial, target_position, until=until, **options)
+
+    def _zero_for_scan(self, serial):
+        zero = self.zero_positions.get(serial)
+        if zero is None:
+            raise ValueError(f"Zero position not set for delay line {serial}")
+        return zero
+
+    def scan_picoseconds(self, serial, delays_ps, dwell, tolerance=0.001):
+        """Worker-side step scan over delays (ps, relative to zero), dwelling dwell seconds per point
+        once the stage has settled within tolerance (mm). Results: scan_results_picoseconds()"""
+        zero = self._zero_for_scan(serial)
+        positions = [zero + self.picoseconds_to_mm(ps) for ps in delays_ps]
+        return self.run_position_scan(serial, positions, dwell, tolerance)
+
+    def fly_scan_picoseconds(self, serial, start_ps, stop_ps, velocity, sample_interval=None):
+        """Worker-side continuous sweep from start_ps to stop_ps at a fraction (0-1) of the
+        maximum velocity, sampling the position at a fixed rate"""
+        zero = self._zero_for_scan(serial)
+        return self.run_fly_scan(
+            serial, zero + self.picoseconds_to_mm(start_ps), zero + self.picoseconds_to_mm(stop_ps),
+            velocity, sample_interval,
+        )
+
+    def scan_results_picoseconds(self, serial):
+        """Last scan's points with positions converted to delays relative to zero"""
+        zero = self._zero_for_scan(serial)
+        results = []
+        for point in self.scan_results(serial):
+            if isinstance(point, dict):
+                point = dict(point, delay_ps=self.mm_to_picoseconds(point["position"] - zero))
+            else:
+                point = (point[0], self.mm_to_picoseconds(point[1] - zero))
+            results.append(point)
+        return results
+
     def updateSlot(self, status):
+        status, changed = self._status_merger.merge(status)
+        if not changed:
+            return
+
         # Create widgets for hardcoded delay lines if they exist
         available_devices = status.get("apt_devices", [])
+        new_rows = set()
         for serial in self.hardcoded_delaylines:
             if serial in available_devices and serial not in self.widgets:
                 self.appendRow(serial)
+                new_rows.add(serial)
 
-        # Update existing widgets
+        # Update widgets of motors whose status changed
         for serial in self.widgets:
-            if serial in available_devices:
+            if serial in available_devices and (serial in new_rows or "apt_{0}".format(serial) in changed):
                 motor_status = status.get("apt_{0}".format(serial), {})
                 widgets = self.widgets[serial]
 
@@ -1,7 +1,10 @@
 # -*- coding: utf-8 -*-
 
 
+import queue
+import threading
 import time
+from concurrent.futures import Future
 
 from PyQt5 import QtCore, QtWidgets
 
@@ -13,6 +16,10 @@ from devices.zeromq_device import (
     include_remote_methods,
     remote,
 )
+from devices.async_calls import AsyncOperationsMixin
+from devices.background_init import BackgroundInitMixin
+from devices.metrics import MetricsMixin
+from devices.status_delta import DeltaStatusMixin, StatusMerger
 
 default_req_port = 7008
 default_pub_port = 7009
@@ -39,14 +46,26 @@ class APTParameter(Parameter):
         return not self.apt.is_stopped()
 
 
-class APTWorker(DeviceWorker):
-    """Class managing all Thorlabs APT  motor controllers"""
+class APTWorker(DeltaStatusMixin, MetricsMixin, AsyncOperationsMixin, BackgroundInitMixin, DeviceWorker):
+    """Class managing all Thorlabs APT  motor controllers
 
-    def __init__(self, req_port=default_req_port, pub_port=default_pub_port, **kwargs):
+    Every motor gets its own command queue and thread. The thread enforces the
+    controller's request rate limit, runs queued commands and refreshes the
+    cached motor status in between, so a slow motor never holds up the others
+    and status() does not talk to the hardware at all."""
+
+    def __init__(self, req_port=default_req_port, pub_port=default_pub_port, poll_interval=0.1, **kwargs):
+        """poll_interval: seconds between status refreshes of an idle motor"""
         super().__init__(req_port=req_port, pub_port=pub_port, **kwargs)
         self.motors = {}
-
-    def init_device(self):
+        self.poll_interval = float(poll_interval)
+        self._queues = {}
+        self._cache = {}
+        self._refreshed = {}
+        self._threads = {}
+        self._scans = {}
+
+    def _init_hardware(self):
         from . import apt_wrapper
 
         serials = [n for (t, n) in apt_wrapper.list_available_devices()]
@@ -58,39 +77,90 @@ class APTWorker(DeviceWorker):
             mot.initial_parameters = mot.get_velocity_parameters()
             mot.prev_request_time = time.time()
             self.motors[n] = mot
+            self._queues[n] = queue.Queue()
+            self._refresh(n, mot)
+            self._threads[n] = threading.Thread(target=self._motor_loop, args=(n,), daemon=True)
+            self._threads[n].start()
 
     min_request_delay = 0.05
+    command_timeout = 10.0
 
     def wait(self, motor):
+        """Rate limit per motor; only ever called from that motor's own thread"""
         now = time.time()
         elapsed = now - motor.prev_request_time
         if elapsed > 0 and elapsed < self.min_request_delay:
             time.sleep(self.min_request_delay - elapsed)
         motor.prev_request_time = now
 
+    def _refresh(self, serial, motor):
+        self._cache[serial] = {
+            "position": motor.position,
+            "stopped": not motor.is_in_motion,
+            "homed": motor.has_homing_been_completed,
+        }
+        self._refreshed[serial] = time.time()
+
+    def _motor_loop(self, serial):
+        mot = self.motors[serial]
+        commands = self._queues[serial]
+        next_refresh = time.time() + self.poll_interval
+        while True:
+            try:
+                func, future, queued_at = commands.get(timeout=max(0.0, next_refresh - time.time()))
+            except queue.Empty:
+                func = None
+            self.wait(mot)
+            if func is None:
+                try:
+                    self._refresh(serial, mot)
+                except Exception as e:
+                    self._metrics.error("refresh", e)
+                    print(f"APT {serial}: status refresh failed: {e}")
+                next_refresh = time.time() + self.poll_interval
+                continue
+            if not future.set_running_or_notify_cancel():
+                continue
+            # Queue wait includes the rate-limit sleep in wait()
+            self._metrics.observe("queue_wait", time.perf_counter() - queued_at)
+            try:
+                with self._metrics.timed("command"):
+                    result = func(mot)
+                future.set_result(result)
+            except Exception as e:
+                self._metrics.error("command", e)
+                future.set_exception(e)
+            # Refresh right after a command so a started move shows up in the next status
+            next_refresh = time.time()
+
+    def _submit(self, serial, func, wait=True):
+        """Queues func(motor) on the motor's thread; returns its result unless wait=False"""
+        future = Future()
+        self._queues[serial].put((func, future, time.perf_counter()))
+        if not wait:
+            return future
+        return future.result(self.command_timeout)
+
     def status(self):
         d = super().status()
+        # Snapshots: background init may still be adding motors while status() is published
         d["apt_devices"] = self.devices()
-        for sn in self.motors:
-            motor = self.motors[sn]
-            self.wait(motor)
-            d["apt_{0}".format(sn)] = {
-                "position": motor.position,
-                "stopped": not motor.is_in_motion,
-                "homed": motor.has_homing_been_completed,
-            }
-        return d
+        for sn in d["apt_devices"]:
+            d["apt_{0}".format(sn)] = dict(self._cache.get(sn, {}))
+        d["apt_scans"] = {sn: dict(scan["progress"]) for sn, scan in list(self._scans.items())}
+        return self._publish_status(d)
 
     @remote
     def move_absolute(self, serial, target):
-        mot = self.motors[serial]
-        self.wait(mot)
-        mot.set_velocity_parameters(*mot.initial_parameters)
-        mot.move_to(target)
+        def move(mot):
+            mot.set_velocity_parameters(*mot.initial_parameters)
+            mot.move_to(target)
+
+        self._submit(serial, move)
 
     @remote
     def devices(self):
-        return [sn for sn in self.motors]
+        return list(self.motors)
 
     @remote
     def axes(self):
@@ -101,39 +171,204 @@ class APTWorker(DeviceWorker):
         if velocity == 0:
             return self.stop(serial)
         """ velocity should be between -1 to 1 """
-        mot = self.motors[serial]
-        self.wait(mot)
-        mot.maximum_velocity = abs(velocity) * mot.initial_parameters[2]
-        direction = 1 if velocity > 0 else 2
-        mot.move_velocity(direction)
+
+        def move(mot):
+            mot.maximum_velocity = abs(velocity) * mot.initial_parameters[2]
+            direction = 1 if velocity > 0 else 2
+            mot.move_velocity(direction)
+
+        self._submit(serial, move)
 
     @remote
     def stop(self, serial):
-        mot = self.motors[serial]
-        self.wait(mot)
-        mot.set_velocity_parameters(*mot.initial_parameters)
-        mot.stop_profiled()
+        def stop(mot):
+            mot.set_velocity_parameters(*mot.initial_parameters)
+            mot.stop_profiled()
+
+        self._submit(serial, stop)
 
     @remote
     def get_position(self, serial):
-        mot = self.motors[serial]
-        self.wait(mot)
-        return mot.position
+        return self._submit(serial, lambda mot: mot.position)
 
     @remote
     def is_stopped(self, serial):
-        mot = self.motors[serial]
-        return not mot.is_in_motion
+        return self._submit(serial, lambda mot: not mot.is_in_motion)
+
+    @remote
+    def is_settled(self, serial, target, tolerance=0.001):
+        """True once the motor is stopped within tolerance (mm) of target. Unlike is_stopped this
+        cannot pass right after a move command, before is_in_motion turned True"""
+        position, stopped = self._read_motion(serial)
+        return stopped and abs(position - target) <= tolerance
 
     @remote
     def homed(self, serial):
-        mot = self.motors[serial]
-        return mot.homed()
+        return self._submit(serial, lambda mot: mot.homed())
 
     @remote
     def home(self, serial):
-        mot = self.motors[serial]
-        mot.move_home(blocking=False)
+        self._submit(serial, lambda mot: mot.move_home(blocking=False))
+
+    # is_in_motion can still read False right after a move command, so a move only counts as
+    # done once it was seen moving or this long has passed
+    _MOVE_START_GRACE = 0.5
+
+    def _completion_check(self, method, args, kwargs):
+        """call_async: home and move_absolute complete with the position once the motor stopped"""
+        if method not in ("home", "move_absolute"):
+            return None
+        serial = args[0] if args else kwargs["serial"]
+        started = time.time()
+        seen_moving = [False]
+
+        def check():
+            state = self._cache.get(serial, {})
+            if self._refreshed.get(serial, 0) <= started:
+                return False, None
+            if not state["stopped"]:
+                seen_moving[0] = True
+                return False, None
+            if not seen_moving[0] and time.time() - started < self._MOVE_START_GRACE:
+                return False, None
+            if method == "home" and not state["homed"]:
+                raise RuntimeError(f"APT {serial} stopped without completing homing")
+            return True, state["position"]
+
+        return check
+
+    def _read_motion(self, serial):
+        """Fresh (position, stopped) read through the motor's queue"""
+        return self._submit(serial, lambda mot: (mot.position, not mot.is_in_motion))
+
+    # Pause between settle reads, so a waiting scan leaves the motor's queue free for other commands
+    settle_poll_interval = 0.05
+
+    def _wait_settled(self, serial, target, tolerance, timeout, stop_event):
+        """Waits until the motor reports stopped within tolerance of target; returns the position"""
+        deadline = time.monotonic() + timeout
+        while not stop_event.is_set():
+            position, stopped = self._read_motion(serial)
+            if stopped and abs(position - target) <= tolerance:
+                return position
+            if time.monotonic() + self.settle_poll_interval > deadline:
+                raise TimeoutError(f"APT {serial} did not settle at {target} (at {position})")
+            stop_event.wait(self.settle_poll_interval)
+        return None
+
+    def _start_scan(self, serial, target, args, total):
+        if serial not in self.motors:
+            raise ValueError(f"Unknown APT motor {serial}")
+        running = self._scans.get(serial)
+        if running is not None and running["thread"].is_alive():
+            raise RuntimeError(f"A scan is already running on APT {serial}")
+        scan = {
+            "stop": threading.Event(),
+            "points": [],
+            "progress": {"running": True, "index": 0, "total": total, "error": None},
+        }
+        scan["thread"] = threading.Thread(target=target, args=(serial, scan) + args, daemon=True)
+        self._scans[serial] = scan
+        scan["thread"].start()
+        return True
+
+    @remote
+    def run_position_scan(self, serial, positions, dwell, tolerance=0.001, settle_timeout=30.0):
+        """Steps the motor through absolute positions, dwelling once each move has settled.
+        Settling is detected from the motor's own status, not a fixed sleep. Every point records
+        the target, settled position and timestamps (seconds from scan start); see scan_results()."""
+        positions = [float(p) for p in positions]
+        if not positions:
+            raise ValueError("Empty scan")
+        return self._start_scan(
+            serial, self._position_scan_loop,
+            (positions, float(dwell), float(tolerance), float(settle_timeout)), len(positions),
+        )
+
+    def _position_scan_loop(self, serial, scan, positions, dwell, tolerance, settle_timeout):
+        start = time.monotonic()
+        progress = scan["progress"]
+        try:
+            for i, target in enumerate(positions):
+                if scan["stop"].is_set():
+                    break
+                point = {"target": target, "move_start": time.monotonic() - start}
+                self.move_absolute(serial, target)
+                point["position"] = self._wait_settled(serial, target, tolerance, settle_timeout, scan["stop"])
+                if point["position"] is None:
+                    break
+                point["settled"] = time.monotonic() - start
+                scan["stop"].wait(dwell)
+                point["dwell_end"] = time.monotonic() - start
+                scan["points"].append(point)
+                progress.update(index=i + 1, last_point=point)
+        except Exception as e:
+            progress["error"] = str(e)
+            print(f"APT {serial}: scan aborted: {e}")
+        finally:
+            progress.update(running=False, elapsed=time.monotonic() - start)
+
+    @remote
+    def run_fly_scan(self, serial, start, stop, velocity, sample_interval=None, tolerance=0.001, timeout=300.0):
+        """Moves to start, then sweeps towards stop with move_velocity (velocity: fraction 0-1 of the
+        maximum) while sampling the position every sample_interval seconds (no faster than the
+        controller's rate limit). Samples are (time from sweep start, position) pairs."""
+        if not 0 < abs(velocity) <= 1:
+            raise ValueError("velocity should be between 0 and 1")
+        interval = max(float(sample_interval or self.min_request_delay), self.min_request_delay)
+        return self._start_scan(
+            serial, self._fly_scan_loop,
+            (float(start), float(stop), abs(float(velocity)), interval, float(tolerance), float(timeout)), 0,
+        )
+
+    def _fly_scan_loop(self, serial, scan, start, stop, velocity, interval, tolerance, timeout):
+        progress = scan["progress"]
+        direction = 1 if stop > start else -1
+        t0 = time.monotonic()
+        try:
+            self.move_absolute(serial, start)
+            if self._wait_settled(serial, start, tolerance, timeout, scan["stop"]) is None:
+                return
+            t0 = time.monotonic()
+            self.move_velocity(serial, direction * velocity)
+            next_sample = t0
+            moving = False
+            while not scan["stop"].is_set():
+                position, stopped = self._read_motion(serial)
+                now = time.monotonic() - t0
+                scan["points"].append((now, position))
+                progress.update(index=len(scan["points"]), last_point=(now, position))
+                # The first reads can still report stopped before the sweep gets going
+                moving = moving or not stopped
+                if (position - stop) * direction >= 0 or (moving and stopped) or now > timeout:
+                    break
+                # Fixed-rate schedule; a slow read shortens the next wait instead of shifting all samples
+                next_sample += interval
+                scan["stop"].wait(max(0.0, next_sample - time.monotonic()))
+        except Exception as e:
+            progress["error"] = str(e)
+            print(f"APT {serial}: fly scan aborted: {e}")
+        finally:
+            try:
+                self.stop(serial)
+            except Exception as e:
+                print(f"APT {serial}: could not stop after the fly scan: {e}")
+            progress.update(running=False, elapsed=time.monotonic() - t0)
+
+    @remote
+    def scan_results(self, serial):
+        """Points recorded by the last scan on this motor"""
+        scan = self._scans.get(serial)
+        return list(scan["points"]) if scan else []
+
+    @remote
+    def stop_scan(self, serial):
+        scan = self._scans.get(serial)
+        if scan is None:
+            return {}
+        scan["stop"].set()
+        scan["thread"].join(timeout=5)
+        return dict(scan["progress"])
 
     @remote
     def get_name(self, axis):  # TODO: read axis names from config file like in stepper
@@ -155,6 +390,7 @@ class APT(DeviceOverZeroMQ):
         super().__init__(req_port=req_port, pub_port=pub_port, **kwargs)
         # custom initialization here
         self.widgets = {}
+        self._status_merger = StatusMerger()
         try:
             self._display_fmt = "%." + str(display_decimal_places) + "f"
             self._display_fmt % 0.5  # raises exception if the format is incorrect
@@ -222,9 +458,14 @@ class APT(DeviceOverZeroMQ):
         display.mousePressEvent = on_click
 
     def updateSlot(self, status):
+        status, changed = self._status_merger.merge(status)
+        if not changed:
+            return
         for serial in status["apt_devices"]:
             if serial not in self.widgets:
                 self.appendRow(serial)
+            elif "apt_{0}".format(serial) not in changed:
+                continue
             motor_status = status["apt_{0}".format(serial)]
             self.widgets[serial][0].display(
                 self._display_fmt % motor_status["position"]
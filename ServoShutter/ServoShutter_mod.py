@@ -1,5 +1,8 @@
+import json
+import os
+import queue
 import threading
-from time import sleep, time
+from time import perf_counter, sleep, time
 
 import serial
 import serial.tools.list_ports
@@ -9,12 +12,17 @@ from devices.zeromq_device import (
     include_remote_methods,
     remote,
 )
+from devices.async_calls import AsyncOperationsMixin
+from devices.background_init import BackgroundInitMixin
+from devices.metrics import MetricsMixin
+from devices.status_delta import DeltaStatusMixin
+from devices.ui_updates import RenderCache, StatusThrottle
 from PyQt6 import QtCore, QtWidgets
 from PyQt6.QtCore import QEasingCurve
 from PyQt6_SwitchControl import SwitchControl
 
 
-class ShutterWorker(DeviceWorker):
+class ShutterWorker(DeltaStatusMixin, MetricsMixin, AsyncOperationsMixin, BackgroundInitMixin, DeviceWorker):
     def __init__(
         self,
         *args,
@@ -24,11 +32,15 @@ class ShutterWorker(DeviceWorker):
         baud=115200,
         servo_count=1,
         pins=[4],
+        heartbeat_ms=500,
+        max_in_flight=4,
+        port_cache=None,
         **kwargs,
     ):
         super().__init__(*args, **kwargs)
         self.baud = baud
         self.com = com
+        self._configured_com = com
         self.vid = vid
         self.pid = pid
         self._connected = False
@@ -53,6 +65,7 @@ class ShutterWorker(DeviceWorker):
 
         # Protocol constants
         self.PKT_START = 0xAA
+        self.PKT_START_SEQ = 0xAB
         self.PKT_END = 0x55
         self.MAX_PACKET_SIZE = 32
 
@@ -64,16 +77,104 @@ class ShutterWorker(DeviceWorker):
         self.CMD_MOVE_STEPPED = 0x05
         self.CMD_STOP_MOVE = 0x06
         self.CMD_GET_MOVE_STATUS = 0x07
+        self.CMD_SET_MANY = 0x08
+        self.CMD_MOVE_STEPPED_MANY = 0x09
+        self.CMD_SUBSCRIBE = 0x0A
+        self.CMD_STATUS_PUSH = 0x0B
+        self.CMD_CONFIG_TRIGGER = 0x0C
+        self.CMD_ARM_TRIGGER = 0x0D
+        self.CMD_GET_TRIGGER_STATUS = 0x0E
+        self.CMD_MOVE_PROFILE = 0x0F
+
+        # On-device motion profiles; presets index the firmware's
+        # velocity/acceleration table (0 gentle ... 3 servo-limited)
+        self.PROFILES = {"linear": 0, "trapezoid": 1, "scurve": 2}
+        self.PRESET_COUNT = 4
+
+        # On-device move sequences
+        self.CMD_SEQ_UPLOAD = 0x10
+        self.CMD_SEQ_CONTROL = 0x11
+        self.CMD_SEQ_STATUS = 0x12
+        self.MAX_SEQUENCE_ENTRIES = 64
+        self.SEQ_ENTRIES_PER_PACKET = 3
+
+        # Firmware runtime counters (loop period, ISR latency, bad frames)
+        self.CMD_GET_STATS = 0x13
+        self.FIRMWARE_STATS_FIELDS = (
+            "loop_avg_us",
+            "loop_max_us",
+            "isr_latency_avg_us",
+            "isr_latency_max_us",
+            "isr_duration_max_us",
+            "frames_dropped",
+            "frames_invalid",
+            "frames_handled",
+        )
+
+        # Per-servo calibration and motion profile kept in the controller's
+        # flash; with it open/close is a 2-byte CMD_MOVE_PRESET packet
+        self.CMD_SET_CONFIG = 0x14
+        self.CMD_GET_CONFIG = 0x15
+        self.CMD_SAVE_CONFIG = 0x16
+        self.CMD_MOVE_PRESET = 0x17
+        self.CONFIG_RECORD_SIZE = 8
+        self.CONFIG_KEYS = ("closed_pw", "open_pw", "step_deg", "step_delay_ms", "profile", "preset")
+        self.PRESET_OPEN = 0x01
+        self.PRESET_STEPPED = 0x02
+        self._onboard_config = False
+        self._config_dirty = set()  # servo indices whose settings the controller doesn't have yet
+
+        # Hardware trigger inputs (numbered 1-2 on the host side)
+        self.TRIGGER_COUNT = 2
+        self.TRIGGER_MODES = {None: 0, "immediate": 1, "stepped": 2}
+        self.TRIGGER_EDGES = {"off": 0, "rising": 1, "falling": 2, "both": 3}
 
         # Response codes
         self.RESP_OK = 0x00
         self.RESP_ERROR = 0xFF
 
-        # Status caching for performance
+        # Status caching for performance; _status_updates counts cache refreshes from the controller
         self._cached_status = {}
+        self._status_updates = 0
         self._monitor_active = False
         self._monitor_thread = None
 
+        # Status streaming: the reader thread owns all port reads, routes
+        # CMD_STATUS_PUSH frames into _cached_status and queues the rest
+        self.heartbeat_ms = heartbeat_ms
+        self._streaming = False
+        self._reader_thread = None
+        self._reader_stop = threading.Event()
+        self._replies = queue.Queue()
+
+        # Protocol v2: sequence-numbered frames, replies matched through
+        # _pending so several requests can be in flight at once
+        self.PROTOCOL_VERSION = 2
+        self._protocol_version = 1
+        self._pending = {}
+        self._pending_lock = threading.Lock()
+        self._write_lock = threading.Lock()
+        self._next_seq = 0
+        self._inflight = threading.BoundedSemaphore(max_in_flight)
+
+        # Receive buffer for the frame decoder; the port timeout only bounds
+        # how long a single blocking read may wait for the first byte
+        self._rx_buf = bytearray()
+        self._rx_started = None  # when the first byte still sitting in _rx_buf arrived
+        self._read_timeout = 0.05
+
+        # Last CMD_GET_STATS reply, reported under get_metrics()["firmware"]
+        self._firmware_stats = None
+
+        # Startup / reconnect: ping right away and back off instead of a fixed
+        # sleep, trying the last port the controller was seen on first
+        self.HANDSHAKE_TIMEOUTS = (0.05, 0.1, 0.2, 0.4)
+        self._port_cache_file = port_cache or os.path.join(
+            os.path.dirname(os.path.abspath(__file__)), ".servo_ports.json"
+        )
+        self._reconnect_lock = threading.Lock()
+        self._reconnect_thread = None
+
         # Settings (can be updated from UI) - only for configured servos
         self.servo_settings = {
             idx: {
@@ -81,136 +182,545 @@ class ShutterWorker(DeviceWorker):
                 "open_pw": 1600,
                 "step_deg": 6.0,
                 "step_delay_ms": 12,
+                "profile": "linear",
+                "preset": 1,
                 "name": f"Servo {pin}",
                 "pin": pin,
             }
             for idx, pin in enumerate(self.pins)
         }
 
-    def _calculate_checksum(self, length, cmd, data):
+    def _calculate_checksum(self, length, cmd, data, seq=None):
         """Calculate XOR checksum"""
         checksum = length ^ cmd
+        if seq is not None:
+            checksum ^= seq
         for byte in data:
             checksum ^= byte
         return checksum
 
-    def _send_packet(self, cmd, data):
-        """Send a packet with proper framing and checksum"""
+    def _send_packet(self, cmd, data, seq=None):
+        """Send a packet with proper framing and checksum (v2 framing if seq is given)"""
         packet = bytearray()
-        packet.append(self.PKT_START)
-        packet.append(len(data))
+        if seq is None:
+            packet.append(self.PKT_START)
+            packet.append(len(data))
+        else:
+            packet.append(self.PKT_START_SEQ)
+            packet.append(len(data))
+            packet.append(seq)
         packet.append(cmd)
         packet.extend(data)
-        checksum = self._calculate_checksum(len(data), cmd, data)
+        checksum = self._calculate_checksum(len(data), cmd, data, seq)
         packet.append(checksum)
         packet.append(self.PKT_END)
 
-        self.comp.write(bytes(packet))
-        self.comp.flush()
+        with self._write_lock:
+            try:
+                with self._metrics.timed("serial_write"):
+                    self.comp.write(bytes(packet))
+                    self.comp.flush()
+            except serial.SerialException as e:
+                self._handle_io_error(e)
+                raise
+
+    def _extract_frame(self):
+        """Pull the next valid frame out of _rx_buf, or None if it holds no complete frame
+
+        Bytes before a start marker are dropped; a frame with a bad length,
+        checksum or end marker is skipped one byte at a time so the decoder
+        resyncs on the next start marker.
+        """
+        buf = self._rx_buf
+        while buf:
+            starts = [i for i in (buf.find(self.PKT_START), buf.find(self.PKT_START_SEQ)) if i >= 0]
+            if not starts:
+                buf.clear()
+                return None
+            del buf[: min(starts)]
+
+            has_seq = buf[0] == self.PKT_START_SEQ
+            header = 4 if has_seq else 3
+            if len(buf) < 2:
+                return None
+            length = buf[1]
+            if length > self.MAX_PACKET_SIZE:
+                self._metrics.count("framing_errors")
+                del buf[0]
+                continue
+            total = header + length + 2
+            if len(buf) < total:
+                return None
+
+            seq = buf[2] if has_seq else None
+            cmd = buf[header - 1]
+            data = bytes(buf[header : header + length])
+            checksum = buf[header + length]
+            end_marker = buf[header + length + 1]
+
+            if end_marker != self.PKT_END or checksum != self._calculate_checksum(
+                length, cmd, data, seq
+            ):
+                self._metrics.count("checksum_errors")
+                del buf[0]
+                continue
+
+            del buf[:total]
+            return {"cmd": cmd, "data": data, "length": length, "seq": seq}
+        return None
+
+    def _read_frame(self, timeout=0.1):
+        """Receive and validate a packet straight from the port
+
+        Blocks in the port read (bounded by the short port timeout) instead
+        of polling in_waiting, and takes whatever bytes are available at once.
+        """
+        deadline = time() + timeout
+        while True:
+            started = perf_counter()
+            pkt = self._extract_frame()
+            if pkt is not None:
+                self._metrics.observe("parse", perf_counter() - started)
+                # Later frames from the same chunk count as arriving with it
+                pkt["rx_at"] = self._rx_started
+                if not self._rx_buf:
+                    self._rx_started = None
+                return pkt
+            if time() >= deadline:
+                return None
+            chunk = self.comp.read(max(1, self.comp.in_waiting))
+            if chunk:
+                if not self._rx_buf or self._rx_started is None:
+                    self._rx_started = perf_counter()
+                self._rx_buf.extend(chunk)
+
+    def _reader_running(self):
+        return self._reader_thread is not None and self._reader_thread.is_alive()
+
+    def _stop_reader(self, timeout=1.0):
+        """Stop the reader thread so the handshake has the port and _rx_buf to itself
+
+        Returns False if it is still running after timeout.
+        """
+        if not self._reader_running():
+            return True
+        self._reader_stop.set()
+        self._reader_thread.join(timeout)
+        return not self._reader_running()
 
     def _receive_packet(self, timeout=0.1):
-        """Receive and validate a packet"""
-        start_time = time()
-
-        while time() - start_time < timeout:
-            if self.comp.in_waiting > 0:
-                byte = self.comp.read(1)
-                if byte[0] == self.PKT_START:
-                    break
-        else:
+        """Wait for the next reply packet (status pushes never show up here)"""
+        if not self._reader_running():
+            return self._read_frame(timeout)
+        try:
+            return self._replies.get(timeout=timeout)
+        except queue.Empty:
             return None
 
-        start_time = time()
-        while self.comp.in_waiting < 1 and time() - start_time < timeout:
-            sleep(0.001)
-        if self.comp.in_waiting < 1:
-            return None
+    def _pipelined(self):
+        return self._protocol_version >= 2 and self._reader_running()
+
+    def _open_slot(self):
+        """Reserve a free sequence number in the pending-request table"""
+        with self._pending_lock:
+            for _ in range(256):
+                seq = self._next_seq
+                self._next_seq = (self._next_seq + 1) & 0xFF
+                if seq not in self._pending:
+                    slot = {"seq": seq, "event": threading.Event(), "pkt": None}
+                    self._pending[seq] = slot
+                    return slot
+        raise IOError("No free sequence numbers")
+
+    def _close_slot(self, seq, pkt=None):
+        """Remove a request from the pending table; returns False if already closed"""
+        with self._pending_lock:
+            slot = self._pending.pop(seq, None)
+        if slot is None:
+            return False
+        slot["pkt"] = pkt
+        slot["done_at"] = perf_counter()
+        slot["event"].set()
+        self._inflight.release()
+        return True
+
+    def _transact_many(self, requests, timeout=0.1):
+        """Send (cmd, data) requests and return their replies in order (None on timeout)
+
+        With protocol v2 all requests are written back to back, at most
+        max_in_flight at a time, and replies are matched by sequence number.
+        Older firmware gets one request at a time under _command_lock.
+        """
+        if not self._pipelined():
+            replies = []
+            waited = perf_counter()
+            with self._command_lock:
+                self._metrics.observe("command_lock_wait", perf_counter() - waited)
+                for cmd, data in requests:
+                    self._reset_input()
+                    self._send_packet(cmd, data)
+                    sent_at = perf_counter()
+                    pkt = self._receive_packet(timeout)
+                    self._note_reply(sent_at, pkt)
+                    replies.append(pkt)
+            return replies
+
+        slots = []
+        for cmd, data in requests:
+            waited = perf_counter()
+            if not self._inflight.acquire(timeout=timeout):
+                self._metrics.count("inflight_timeouts")
+                slots.append(None)
+                continue
+            self._metrics.observe("inflight_wait", perf_counter() - waited)
+            slot = self._open_slot()
+            slots.append(slot)
+            try:
+                self._send_packet(cmd, data, seq=slot["seq"])
+                slot["sent_at"] = perf_counter()
+            except Exception:
+                self._close_slot(slot["seq"])
+                raise
+
+        replies = []
+        for slot in slots:
+            if slot is None:
+                replies.append(None)
+                continue
+            slot["event"].wait(timeout)
+            self._close_slot(slot["seq"])
+            self._note_reply(slot.get("sent_at"), slot["pkt"], slot.get("done_at"))
+            replies.append(slot["pkt"])
+        return replies
+
+    def _note_reply(self, sent_at, pkt, done_at=None):
+        """Record reply timing: first reply byte and full round trip after the request went out"""
+        if pkt is None:
+            self._metrics.count("timeouts")
+            return
+        if sent_at is None:
+            return
+        if pkt.get("rx_at") is not None:
+            self._metrics.observe("first_byte", max(pkt["rx_at"] - sent_at, 0.0))
+        self._metrics.observe("round_trip", (done_at or perf_counter()) - sent_at)
 
-        length = self.comp.read(1)[0]
-        if length > self.MAX_PACKET_SIZE:
-            return None
+    def _transact(self, cmd, data, timeout=0.1):
+        """Send one request and wait for its reply"""
+        return self._transact_many([(cmd, data)], timeout)[0]
 
-        start_time = time()
-        while self.comp.in_waiting < 1 and time() - start_time < timeout:
-            sleep(0.001)
-        if self.comp.in_waiting < 1:
-            return None
+    def _reset_input(self):
+        """Discard stale replies before sending a new command"""
+        if not self._reader_running():
+            self.comp.reset_input_buffer()
+            self._rx_buf.clear()
+            return
+        while True:
+            try:
+                self._replies.get_nowait()
+            except queue.Empty:
+                return
 
-        cmd = self.comp.read(1)[0]
+    def _init_hardware(self):
+        self._monitor_active = True
+        if not self._connect():
+            print(
+                "Device may not be connected.\nInitialization function can't find Nucleo L432KC / F303K8 with VID: 0x0483 and PID: 0x374B at any COM port."
+            )
+            self._start_reconnect()
 
-        start_time = time()
-        while self.comp.in_waiting < length and time() - start_time < timeout:
-            sleep(0.001)
-        if self.comp.in_waiting < length:
+    def _port_key(self):
+        return f"{self.vid:04X}:" + ",".join(f"{pid:04X}" for pid in self.pid)
+
+    def _load_cached_port(self):
+        try:
+            with open(self._port_cache_file) as f:
+                return json.load(f).get(self._port_key())
+        except (OSError, ValueError):
             return None
 
-        data = self.comp.read(length)
+    def _save_cached_port(self, device):
+        try:
+            try:
+                with open(self._port_cache_file) as f:
+                    cache = json.load(f)
+            except (OSError, ValueError):
+                cache = {}
+            if cache.get(self._port_key()) != device:
+                cache[self._port_key()] = device
+                with open(self._port_cache_file, "w") as f:
+                    json.dump(cache, f)
+        except OSError as e:
+            print(f"Could not cache the servo port: {e}")
+
+    def _candidate_ports(self):
+        """Configured and last known ports first; enumerating all ports is the fallback"""
+        seen = set()
+        for device in (self._configured_com, self._load_cached_port()):
+            if device and device not in seen:
+                seen.add(device)
+                yield device
+        for port in serial.tools.list_ports.comports():
+            if port.vid == self.vid and port.pid in self.pid and port.device not in seen:
+                seen.add(port.device)
+                yield port.device
+
+    def _handshake(self):
+        """Ping with growing timeouts; an INIT packet from a freshly reset board also counts"""
+        for timeout in self.HANDSHAKE_TIMEOUTS:
+            with self._command_lock:
+                self._rx_buf.clear()
+                self._send_packet(self.CMD_PING, b"")
+                pkt = self._read_frame(timeout)
+                while pkt is not None and pkt["cmd"] not in (self.CMD_PING, 0xFF):
+                    pkt = self._read_frame(timeout)
+            if pkt is not None:
+                if pkt["cmd"] == 0xFF:
+                    print("Received initialization packet")
+                return True
+        return False
 
-        start_time = time()
-        while self.comp.in_waiting < 2 and time() - start_time < timeout:
-            sleep(0.001)
-        if self.comp.in_waiting < 2:
-            return None
+    def _connect(self):
+        """Find the controller, handshake and start the session; returns True when connected"""
+        # A reader left over from the lost session may still be reading; it restarts with the session
+        if not self._stop_reader():
+            print("Reader thread still running, connect postponed")
+            return False
+        for device in self._candidate_ports():
+            try:
+                self.comp = serial.Serial(device, self.baud, timeout=self._read_timeout)
+            except serial.SerialException:
+                continue
+            print(f"Connecting to: {self.comp.name}")
+            try:
+                self.comp.reset_input_buffer()
+                self.comp.reset_output_buffer()
+                if self._handshake():
+                    print("Device connected ✅")
+                    self.com = device
+                    self._save_cached_port(device)
+                    self._connected = True
+                    self._start_session()
+                    return True
+                print("Ping failed")
+            except Exception as e:
+                print(f"Error initializing device: {e}")
+                self._connected = False
+            self.comp.close()
+        return False
 
-        checksum = self.comp.read(1)[0]
-        end_marker = self.comp.read(1)[0]
+    def _start_session(self):
+        self._negotiate_protocol()
+        self._load_onboard_config()
+        if not self._reader_running():
+            self._reader_stop.clear()
+            self._reader_thread = threading.Thread(
+                target=self._reader_loop, daemon=True
+            )
+            self._reader_thread.start()
+        self._subscribe()
+
+        # Fall back to polling if the firmware cannot stream status
+        if not self._streaming and (
+            self._monitor_thread is None or not self._monitor_thread.is_alive()
+        ):
+            self._monitor_thread = threading.Thread(
+                target=self._monitor_loop, daemon=True
+            )
+            self._monitor_thread.start()
 
-        if end_marker != self.PKT_END:
-            return None
+    def _handle_io_error(self, error):
+        """Drop the dead port, fail waiting requests and reconnect in the background"""
+        with self._reconnect_lock:
+            if not self._connected:
+                return
+            self._connected = False
+            self._streaming = False
+        print(f"Lost connection to the servo controller: {error}")
+        try:
+            self.comp.close()
+        except Exception:
+            pass
+        for seq in list(self._pending):
+            self._close_slot(seq)
+        self._start_reconnect()
+
+    def _start_reconnect(self):
+        with self._reconnect_lock:
+            if self._reconnect_thread is not None and self._reconnect_thread.is_alive():
+                return
+            self._reconnect_thread = threading.Thread(
+                target=self._reconnect_loop, daemon=True
+            )
+            self._reconnect_thread.start()
 
-        expected_checksum = self._calculate_checksum(length, cmd, data)
-        if checksum != expected_checksum:
-            return None
+    def _reconnect_loop(self):
+        delay = 0.1
+        while self._monitor_active and not self._connected:
+            sleep(delay)
+            try:
+                if self._connect():
+                    print("Reconnected to the servo controller")
+                    return
+            except Exception as e:
+                print(f"Reconnect attempt failed: {e}")
+            delay = min(delay * 2, 5.0)
+
+    def _negotiate_protocol(self):
+        """Read the firmware protocol version from the CMD_PING reply"""
+        self._protocol_version = 1
+        pkt = self._transact(self.CMD_PING, b"")
+        if pkt and pkt["cmd"] == self.CMD_PING and pkt["length"] >= 5:
+            self._protocol_version = min(pkt["data"][4], self.PROTOCOL_VERSION)
+        print(f"Protocol version: {self._protocol_version}")
+
+    def _encode_config(self, settings):
+        """One CMD_SET_CONFIG / CMD_GET_CONFIG record from a servo_settings entry"""
+        closed_pw = int(settings["closed_pw"])
+        open_pw = int(settings["open_pw"])
+        step_deg_100 = min(max(int(settings["step_deg"] * 100), 1), 255)
+        delay = min(max(int(settings["step_delay_ms"]), 0), 0xFFFF)
+        profile = self.PROFILES.get(settings.get("profile"), 0)
+        preset = min(max(int(settings.get("preset", 1)), 0), self.PRESET_COUNT - 1)
+        return bytes(
+            [
+                (closed_pw >> 8) & 0xFF,
+                closed_pw & 0xFF,
+                (open_pw >> 8) & 0xFF,
+                open_pw & 0xFF,
+                step_deg_100,
+                (delay >> 8) & 0xFF,
+                delay & 0xFF,
+                (profile << 4) | preset,
+            ]
+        )
 
-        return {"cmd": cmd, "data": data, "length": length}
-
-    def init_device(self):
-        ports = list(serial.tools.list_ports.comports())
-        for port in ports:
-            if port.vid == self.vid and port.pid in self.pid:
-                self.com = port.device
-                try:
-                    self.comp = serial.Serial(self.com, self.baud, timeout=0.5)
-                    print(f"Connecting to: {self.comp.name}")
-
-                    self.comp.reset_input_buffer()
-                    self.comp.reset_output_buffer()
-
-                    sleep(2)
-
-                    pkt = self._receive_packet(timeout=0.5)
-                    if pkt and pkt["cmd"] == 0xFF:
-                        print("Received initialization packet")
-                        self._connected = True
-                    else:
-                        with self._command_lock:
-                            self._send_packet(self.CMD_PING, b"")
-                            pkt = self._receive_packet()
-                            if pkt and pkt["cmd"] == self.CMD_PING:
-                                print("Device connected ✅")
-                                self._connected = True
-                            else:
-                                print("Ping failed")
-
-                    # Start background polling thread if connected
-                    if self._connected and (
-                        self._monitor_thread is None
-                        or not self._monitor_thread.is_alive()
-                    ):
-                        self._monitor_active = True
-                        self._monitor_thread = threading.Thread(
-                            target=self._monitor_loop, daemon=True
-                        )
-                        self._monitor_thread.start()
-
-                except Exception as e:
-                    print(f"Error initializing device: {e}")
-                    self._connected = False
+    def _decode_config(self, record):
+        profiles = {code: name for name, code in self.PROFILES.items()}
+        return {
+            "closed_pw": (record[0] << 8) | record[1],
+            "open_pw": (record[2] << 8) | record[3],
+            "step_deg": record[4] / 100.0,
+            "step_delay_ms": (record[5] << 8) | record[6],
+            "profile": profiles.get(record[7] >> 4, "linear"),
+            "preset": record[7] & 0x0F,
+        }
+
+    def _load_onboard_config(self):
+        """Fetch all servo settings from the controller in one read; older firmware keeps host-side settings"""
+        self._onboard_config = False
+        size = self.CONFIG_RECORD_SIZE
+        pkt = self._transact(self.CMD_GET_CONFIG, b"")
+        if not pkt or pkt["cmd"] != self.CMD_GET_CONFIG or pkt["length"] != 4 * size:
+            print("Firmware has no stored servo settings, using host defaults")
+            return
+        for idx, pin in enumerate(self.pins):
+            if idx in self._config_dirty:
+                continue  # changed while disconnected; pushed below
+            hw_idx = pin - 1
+            record = pkt["data"][hw_idx * size : (hw_idx + 1) * size]
+            self.servo_settings[idx].update(self._decode_config(record))
+        self._onboard_config = True
+        for idx in list(self._config_dirty):
+            self._push_config(idx)
+        print("Loaded servo settings from the controller")
+
+    def _push_config(self, servo_idx):
+        """Send one servo's settings to the controller (RAM only until save_settings)"""
+        hw_idx = self.pins[servo_idx] - 1
+        data = bytes([hw_idx]) + self._encode_config(self.servo_settings[servo_idx])
+        try:
+            pkt = self._transact(self.CMD_SET_CONFIG, data)
+            ok = bool(pkt) and pkt["data"][0] == self.RESP_OK
+        except Exception as e:
+            print(f"Error sending settings of servo {servo_idx}: {e}")
+            ok = False
+        if ok:
+            self._config_dirty.discard(servo_idx)
         else:
+            self._config_dirty.add(servo_idx)
+            print(f"Controller rejected settings of servo {servo_idx}; moves use host-side settings")
+        return ok
+
+    def _move_preset(self, targets, action, stepped):
+        """Move all targets with one CMD_MOVE_PRESET packet; False when the stored settings can't be used"""
+        if not self._onboard_config or not targets:
+            return False
+        if any(self.pin_to_idx[t[0]] in self._config_dirty for t in targets):
+            return False
+        mask = 0
+        for ax, hw_idx, settings, pw in targets:
+            mask |= 1 << hw_idx
+        flags = (self.PRESET_OPEN if action == "open" else 0) | (self.PRESET_STEPPED if stepped else 0)
+        pins = [t[0] for t in targets]
+        try:
+            pkt = self._transact(self.CMD_MOVE_PRESET, bytes([mask, flags]))
+            if not pkt or pkt["data"][0] != self.RESP_OK:
+                print(f"Error moving servos on pins {pins}")
+            else:
+                print(f"Moved servos on pins {pins} to {action}")
+        except Exception as e:
+            print(f"Error moving servos on pins {pins}: {e}")
+        return True
+
+    def _subscribe(self):
+        """Ask the firmware to push status frames instead of being polled"""
+        hb = self.heartbeat_ms
+        pkt = self._transact(self.CMD_SUBSCRIBE, bytes([1, (hb >> 8) & 0xFF, hb & 0xFF]))
+        self._streaming = bool(pkt) and pkt["data"][0] == self.RESP_OK
+        if self._streaming:
+            print("Status streaming enabled")
+
+    def _decode_positions(self, data):
+        """Decode 4 big-endian pulse widths into open/position cache entries"""
+        status_update = {}
+        # Only process configured servos
+        for idx, pin in enumerate(self.pins):
+            hw_idx = pin - 1  # Hardware uses 0-indexed
+            pw = (data[hw_idx * 2] << 8) | data[hw_idx * 2 + 1]
+            settings = self.servo_settings[idx]
+            mid_point = (settings["closed_pw"] + settings["open_pw"]) / 2
+            status_update[f"open{pin}"] = pw > mid_point
+            status_update[f"position{pin}"] = pw
+        return status_update
+
+    def _reader_loop(self):
+        """Background thread demultiplexing status pushes from command replies"""
+        while self._monitor_active and not self._reader_stop.is_set():
             if not self._connected:
-                print(
-                    "Device may not be connected.\nInitialization function can't find Nucleo L432KC / F303K8 with VID: 0x0483 and PID: 0x374B at any COM port."
-                )
+                sleep(0.05)
+                continue
+
+            try:
+                pkt = self._read_frame()
+            except serial.SerialException as e:
+                self._handle_io_error(e)
+                continue
+            except Exception as e:
+                self._metrics.error("reader", e)
+                print(f"Error reading from device: {e}")
+                sleep(0.1)
+                continue
+
+            if pkt is None:
+                continue
+
+            if pkt["seq"] is not None:
+                self._close_slot(pkt["seq"], pkt)
+            elif pkt["cmd"] == self.CMD_STATUS_PUSH and pkt["length"] in (9, 13):
+                data = pkt["data"]
+                status_update = self._decode_positions(data[1:])
+                for pin in self.pins:
+                    status_update[f"moving{pin}"] = bool(data[0] & (1 << (pin - 1)))
+                if pkt["length"] == 13:
+                    status_update["sequence"] = {
+                        "running": bool(data[9]),
+                        "index": data[10],
+                        "loops": (data[11] << 8) | data[12],
+                    }
+                self._cached_status.update(status_update)
+                self._status_updates += 1
+            else:
+                self._replies.put(pkt)
 
     def _monitor_loop(self):
         """Background thread to poll device status without blocking UI"""
@@ -220,36 +730,24 @@ class ShutterWorker(DeviceWorker):
                 continue
 
             try:
-                # Use lock to prevent conflict with immediate moves
-                with self._command_lock:
-                    status_update = {}
-                    self.comp.reset_input_buffer()
-                    self._send_packet(self.CMD_GET_ALL, b"")
-                    pkt = self._receive_packet()
-
-                    if pkt and pkt["cmd"] == self.CMD_GET_ALL and pkt["length"] == 8:
-                        # Only process configured servos
-                        for idx, pin in enumerate(self.pins):
-                            hw_idx = pin - 1  # Hardware uses 0-indexed
-                            pw = (pkt["data"][hw_idx * 2] << 8) | pkt["data"][
-                                hw_idx * 2 + 1
-                            ]
-                            settings = self.servo_settings[idx]
-                            mid_point = (
-                                settings["closed_pw"] + settings["open_pw"]
-                            ) / 2
-                            status_update[f"open{pin}"] = pw > mid_point
-                            status_update[f"position{pin}"] = pw
-                    else:
-                        # Fallback to individual query if bulk fails
-                        for idx, pin in enumerate(self.pins):
-                            status_update[f"open{pin}"] = self._state_internal(idx)
-
-                    # Atomic update of the cache
-                    self._cached_status.update(status_update)
+                status_update = {}
+                pkt = self._transact(self.CMD_GET_ALL, b"")
+
+                if pkt and pkt["cmd"] == self.CMD_GET_ALL and pkt["length"] == 8:
+                    status_update = self._decode_positions(pkt["data"])
+                else:
+                    # Fallback to individual query if bulk fails
+                    for idx, pin in enumerate(self.pins):
+                        status_update[f"open{pin}"] = self._state_internal(idx)
+
+                # Atomic update of the cache
+                self._cached_status.update(status_update)
+                self._status_updates += 1
 
+            except serial.SerialException as e:
+                self._handle_io_error(e)
             except Exception as e:
-                pass
+                self._metrics.error("monitor", e)
 
             # Poll rate
             sleep(0.1)
@@ -257,14 +755,15 @@ class ShutterWorker(DeviceWorker):
     def status(self):
         """Non-blocking status check returning cached data"""
         d = super().status()
+        d["serial_connected"] = self._connected
         if not self._connected:
-            return d
+            return self._publish_status(d)
 
         d.update(self._cached_status)
-        return d
+        return self._publish_status(d)
 
     def _state_internal(self, servo_idx):
-        """Internal state query (NOTE: Assumes lock is already held by caller)
+        """Internal state query (takes _command_lock itself on v1 firmware)
         Args:
             servo_idx: Internal index (0-based) into self.pins
         """
@@ -273,10 +772,7 @@ class ShutterWorker(DeviceWorker):
             pin = self.pins[servo_idx]
             hw_idx = pin - 1
 
-            self.comp.reset_input_buffer()
-            data = bytes([hw_idx])
-            self._send_packet(self.CMD_GET_SERVO, data)
-            pkt = self._receive_packet()
+            pkt = self._transact(self.CMD_GET_SERVO, bytes([hw_idx]))
 
             if pkt and pkt["cmd"] == self.CMD_GET_SERVO and pkt["length"] == 3:
                 pw = (pkt["data"][1] << 8) | pkt["data"][2]
@@ -306,8 +802,73 @@ class ShutterWorker(DeviceWorker):
 
         # Convert pin to internal index
         servo_idx = self.pin_to_idx[ax]
-        with self._command_lock:
-            return self._state_internal(servo_idx)
+        return self._state_internal(servo_idx)
+
+    def _resolve_targets(self, action, axes):
+        """Map pin numbers to (pin, hw_idx, settings, target_pw), skipping invalid ones"""
+        targets = []
+        for ax in axes:
+            # Check if this pin is configured
+            if ax not in self.pins:
+                print(f"Pin {ax} not configured")
+                continue
+
+            servo_idx = self.pin_to_idx[ax]
+            hw_idx = ax - 1  # Hardware uses 0-indexed pins
+            settings = self.servo_settings[servo_idx]
+
+            if action == "close":
+                pw = settings["closed_pw"]
+            elif action == "open":
+                pw = settings["open_pw"]
+            else:
+                print(f"Invalid action: {action}")
+                continue
+
+            targets.append((ax, hw_idx, settings, pw))
+        return targets
+
+    # Firmware DEG100_PER_US: 18000 deg100 over the 2000 us pulse width range
+    DEG100_PER_US = 9
+
+    def _step_deg_100(self, settings):
+        """Step size in 1/100 deg as the single byte the firmware takes"""
+        return min(int(settings["step_deg"] * 100), 255)
+
+    def _step_pw(self, settings):
+        """Step size in us as the firmware derives it (stepDeg100ToMicroseconds)"""
+        return max(1, self._step_deg_100(settings) // self.DEG100_PER_US)
+
+    def _stepped_payload(self, target_pw, settings):
+        """Encode target/step/delay the way CMD_MOVE_STEPPED expects them"""
+        # Integer, so the firmware's PW_MIN + deg100 / DEG100_PER_US gives back target_pw exactly
+        target_deg_100 = (target_pw - 500) * self.DEG100_PER_US
+        step_deg_100 = self._step_deg_100(settings)
+
+        return bytes(
+            [
+                (target_deg_100 >> 8) & 0xFF,
+                target_deg_100 & 0xFF,
+                step_deg_100,
+                (settings["step_delay_ms"] >> 8) & 0xFF,
+                settings["step_delay_ms"] & 0xFF,
+            ]
+        )
+
+    def _batch_payload(self, targets, encode):
+        """Servo bitmask followed by encode(pw, settings) for each target"""
+        mask = 0
+        payload = bytearray()
+        # Firmware expects per-servo fields in ascending hardware index order
+        for ax, hw_idx, settings, pw in sorted(targets, key=lambda t: t[1]):
+            mask |= 1 << hw_idx
+            payload.extend(encode(pw, settings))
+        return bytes([mask]) + bytes(payload)
+
+    def _send_batch(self, cmd, targets, encode):
+        """Send one bitmask packet covering several servos; returns True on ACK"""
+        pkt = self._transact(cmd, self._batch_payload(targets, encode))
+        return bool(pkt) and pkt["data"][0] == self.RESP_OK
 
     @remote
     def move_immediate(self, action, *axes):
@@ -316,37 +877,36 @@ class ShutterWorker(DeviceWorker):
             print("Device not connected")
             return
 
-        with self._command_lock:
-            for ax in axes:
-                # Check if this pin is configured
-                if ax not in self.pins:
-                    print(f"Pin {ax} not configured")
-                    continue
-
-                servo_idx = self.pin_to_idx[ax]
-                hw_idx = ax - 1  # Hardware uses 0-indexed pins
-                settings = self.servo_settings[servo_idx]
+        targets = self._resolve_targets(action, axes)
+        if self._move_preset(targets, action, stepped=False):
+            return
 
-                if action == "close":
-                    pw = settings["closed_pw"]
-                elif action == "open":
-                    pw = settings["open_pw"]
+        if len(targets) > 1:
+            pins = [t[0] for t in targets]
+            try:
+                if self._send_batch(
+                    self.CMD_SET_MANY,
+                    targets,
+                    lambda pw, settings: bytes([(pw >> 8) & 0xFF, pw & 0xFF]),
+                ):
+                    print(f"Moved servos on pins {pins} to {action}")
                 else:
-                    print(f"Invalid action: {action}")
-                    continue
+                    print(f"Error moving servos on pins {pins}")
+            except Exception as e:
+                print(f"Error moving servos on pins {pins}: {e}")
+            return
 
-                try:
-                    self.comp.reset_input_buffer()
-                    data = bytes([hw_idx, (pw >> 8) & 0xFF, pw & 0xFF])
-                    self._send_packet(self.CMD_SET_SERVO, data)
-                    pkt = self._receive_packet()
+        for ax, hw_idx, settings, pw in targets:
+            try:
+                data = bytes([hw_idx, (pw >> 8) & 0xFF, pw & 0xFF])
+                pkt = self._transact(self.CMD_SET_SERVO, data)
 
-                    if not pkt or pkt["data"][0] != self.RESP_OK:
-                        print(f"Error moving servo on pin {ax}")
-                    else:
-                        print(f"Moved servo on pin {ax} to {action}")
-                except Exception as e:
-                    print(f"Error moving servo on pin {ax}: {e}")
+                if not pkt or pkt["data"][0] != self.RESP_OK:
+                    print(f"Error moving servo on pin {ax}")
+                else:
+                    print(f"Moved servo on pin {ax} to {action}")
+            except Exception as e:
+                print(f"Error moving servo on pin {ax}: {e}")
 
     @remote
     def move_stepped(self, action, *axes):
@@ -355,53 +915,80 @@ class ShutterWorker(DeviceWorker):
             print("Device not connected")
             return
 
-        with self._command_lock:
-            for ax in axes:
-                # Check if this pin is configured
-                if ax not in self.pins:
-                    print(f"Pin {ax} not configured")
-                    continue
+        targets = self._resolve_targets(action, axes)
+        if self._move_preset(targets, action, stepped=True):
+            return
 
-                servo_idx = self.pin_to_idx[ax]
-                hw_idx = ax - 1  # Hardware uses 0-indexed pins
-                settings = self.servo_settings[servo_idx]
+        profiled = [t for t in targets if t[2].get("profile", "linear") != "linear"]
+        if profiled:
+            self._move_profiled(profiled)
+            targets = [t for t in targets if t not in profiled]
 
-                if action == "close":
-                    target_pw = settings["closed_pw"]
-                elif action == "open":
-                    target_pw = settings["open_pw"]
+        if len(targets) > 1:
+            pins = [t[0] for t in targets]
+            try:
+                if self._send_batch(
+                    self.CMD_MOVE_STEPPED_MANY, targets, self._stepped_payload
+                ):
+                    print(f"Started stepped move for servos {pins}")
                 else:
-                    print(f"Invalid action: {action}")
-                    continue
+                    print(f"Error starting stepped move for servos {pins}")
+            except Exception as e:
+                print(f"Error with stepped move for servos {pins}: {e}")
+            return
 
-                target_deg = ((target_pw - 500) / 2000.0) * 180.0
-                target_deg_100 = int(target_deg * 100)
-                step_deg_100 = int(settings["step_deg"] * 100)
-
-                if step_deg_100 > 255:
-                    step_deg_100 = 255
-
-                try:
-                    self.comp.reset_input_buffer()
-                    data = bytes(
-                        [
-                            hw_idx,
-                            (target_deg_100 >> 8) & 0xFF,
-                            target_deg_100 & 0xFF,
-                            step_deg_100,
-                            (settings["step_delay_ms"] >> 8) & 0xFF,
-                            settings["step_delay_ms"] & 0xFF,
-                        ]
-                    )
-                    self._send_packet(self.CMD_MOVE_STEPPED, data)
-                    pkt = self._receive_packet()
-
-                    if not pkt or pkt["data"][0] != self.RESP_OK:
-                        print(f"Error starting stepped move for servo {ax}")
-                    else:
-                        print(f"Started stepped move for servo {ax}")
-                except Exception as e:
-                    print(f"Error with stepped move for servo {ax}: {e}")
+        for ax, hw_idx, settings, target_pw in targets:
+            try:
+                data = bytes([hw_idx]) + self._stepped_payload(target_pw, settings)
+                pkt = self._transact(self.CMD_MOVE_STEPPED, data)
+
+                if not pkt or pkt["data"][0] != self.RESP_OK:
+                    print(f"Error starting stepped move for servo {ax}")
+                else:
+                    print(f"Started stepped move for servo {ax}")
+            except Exception as e:
+                print(f"Error with stepped move for servo {ax}: {e}")
+
+    def _completion_check(self, method, args, kwargs):
+        """call_async: moves complete once a status update sent after the command shows every servo
+        stopped at its target"""
+        if method not in ("move_stepped", "move_immediate") or not args:
+            return None
+        targets = {ax: pw for ax, hw_idx, settings, pw in self._resolve_targets(args[0], args[1:])}
+        updates = self._status_updates
+
+        def check():
+            if not self._connected:
+                raise ConnectionError("Controller disconnected")
+            if self._status_updates == updates:
+                return False, None
+            status = self._cached_status
+            done = all(
+                not status.get(f"moving{ax}", False) and status.get(f"position{ax}") == pw
+                for ax, pw in targets.items()
+            )
+            return done, None
+
+        return check
+
+    def _move_profiled(self, targets):
+        """Start trapezoid/S-curve moves for all targets in one CMD_MOVE_PROFILE packet"""
+        pins = [t[0] for t in targets]
+
+        def encode(pw, settings):
+            profile = self.PROFILES.get(settings.get("profile"), 1)
+            preset = min(max(int(settings.get("preset", 1)), 0), self.PRESET_COUNT - 1)
+            return bytes([(pw >> 8) & 0xFF, pw & 0xFF, profile, preset])
+
+        try:
+            pkt = self._transact(self.CMD_MOVE_PROFILE, self._batch_payload(targets, encode))
+            if not pkt or pkt["data"][0] != self.RESP_OK:
+                print(f"Error starting profiled move for servos {pins}")
+            else:
+                duration_ms = (pkt["data"][1] << 8) | pkt["data"][2] if pkt["length"] >= 3 else None
+                print(f"Started profiled move for servos {pins} ({duration_ms} ms)")
+        except Exception as e:
+            print(f"Error with profiled move for servos {pins}: {e}")
 
     @remote
     def stop_move(self, *axes):
@@ -409,29 +996,281 @@ class ShutterWorker(DeviceWorker):
         if not self._connected:
             return
 
-        with self._command_lock:
-            for ax in axes:
-                # Check if this pin is configured
-                if ax not in self.pins:
-                    print(f"Pin {ax} not configured")
-                    continue
+        requests = []
+        for ax in axes:
+            # Check if this pin is configured
+            if ax not in self.pins:
+                print(f"Pin {ax} not configured")
+                continue
 
-                hw_idx = ax - 1  # Hardware uses 0-indexed pins
-                try:
-                    self.comp.reset_input_buffer()
-                    data = bytes([hw_idx])
-                    self._send_packet(self.CMD_STOP_MOVE, data)
-                    self._receive_packet()
-                except Exception as e:
-                    print(f"Error stopping servo on pin {ax}: {e}")
+            hw_idx = ax - 1  # Hardware uses 0-indexed pins
+            requests.append((self.CMD_STOP_MOVE, bytes([hw_idx])))
+
+        try:
+            self._transact_many(requests)
+        except Exception as e:
+            print(f"Error stopping servos on pins {list(axes)}: {e}")
+
+    @remote
+    def upload_sequence(self, entries):
+        """Upload a list of timed moves for the firmware to execute on its own
+
+        Each entry is (pin, target, delay_ms[, profile]):
+            pin: servo pin (1-4), or None for a wait-only entry
+            target: "open", "close" or a pulse width in us
+            delay_ms: wait after the previous entry (or after start), float
+            profile: "immediate", "trapezoid" or "scurve"; defaults to the
+                servo's profile setting ("linear" maps to "immediate")
+        Profiled entries use the servo's preset setting.
+        """
+        if not self._connected:
+            print("Device not connected")
+            return False
+        if not 0 < len(entries) <= self.MAX_SEQUENCE_ENTRIES:
+            print(f"Sequence must have 1-{self.MAX_SEQUENCE_ENTRIES} entries")
+            return False
+
+        encoded = []
+        for n, entry in enumerate(entries):
+            pin, target, delay_ms = entry[:3]
+            profile = entry[3] if len(entry) > 3 else None
+            delay_us = int(round(delay_ms * 1000))
+            if not 0 <= delay_us <= 0xFFFFFFFF:
+                print(f"Entry {n}: invalid delay {delay_ms} ms")
+                return False
+
+            if pin is None:
+                encoded.append(bytes([0xFF, 0, 0, 0, 0]) + delay_us.to_bytes(4, "big"))
+                continue
+            if pin not in self.pins:
+                print(f"Entry {n}: pin {pin} not configured")
+                return False
+
+            settings = self.servo_settings[self.pin_to_idx[pin]]
+            if target == "open":
+                pw = settings["open_pw"]
+            elif target == "close":
+                pw = settings["closed_pw"]
+            else:
+                pw = int(target)
+            if profile is None:
+                profile = settings.get("profile", "linear")
+            code = 0 if profile in ("immediate", "linear") else self.PROFILES.get(profile)
+            if code is None:
+                print(f"Entry {n}: invalid profile {profile}")
+                return False
+            preset = min(max(int(settings.get("preset", 1)), 0), self.PRESET_COUNT - 1)
+
+            encoded.append(
+                bytes([pin - 1, (pw >> 8) & 0xFF, pw & 0xFF, code, preset])
+                + delay_us.to_bytes(4, "big")
+            )
+
+        total = len(encoded)
+        requests = []
+        for start in range(0, total, self.SEQ_ENTRIES_PER_PACKET):
+            chunk = encoded[start : start + self.SEQ_ENTRIES_PER_PACKET]
+            requests.append((self.CMD_SEQ_UPLOAD, bytes([start, total]) + b"".join(chunk)))
+
+        replies = self._transact_many(requests)
+        if not all(pkt and pkt["data"][0] == self.RESP_OK for pkt in replies):
+            print("Error uploading sequence (is one already running?)")
+            return False
+        print(f"Uploaded sequence with {total} entries")
+        return True
+
+    @remote
+    def run_sequence(self, loops=1):
+        """Start the uploaded sequence; loops=0 repeats until stop_sequence()"""
+        if not self._connected:
+            print("Device not connected")
+            return False
+        loops = int(loops)
+        pkt = self._transact(
+            self.CMD_SEQ_CONTROL, bytes([1, (loops >> 8) & 0xFF, loops & 0xFF])
+        )
+        if not pkt or pkt["data"][0] != self.RESP_OK:
+            print("Error starting sequence")
+            return False
+        return True
+
+    @remote
+    def stop_sequence(self):
+        if not self._connected:
+            return False
+        pkt = self._transact(self.CMD_SEQ_CONTROL, bytes([0, 0, 0]))
+        return bool(pkt) and pkt["data"][0] == self.RESP_OK
+
+    @remote
+    def sequence_status(self):
+        """Returns {"running", "index", "loops", "length"} read from the device"""
+        if not self._connected:
+            return {}
+        pkt = self._transact(self.CMD_SEQ_STATUS, b"")
+        if not pkt or pkt["cmd"] != self.CMD_SEQ_STATUS or pkt["length"] != 5:
+            print("Error reading sequence status")
+            return {}
+        data = pkt["data"]
+        return {
+            "running": bool(data[0]),
+            "index": data[1],
+            "loops": (data[2] << 8) | data[3],
+            "length": data[4],
+        }
+
+    @remote
+    def configure_trigger(self, trigger, ax, action="close", mode="immediate"):
+        """Bind servo on pin ax (1-4) to hardware trigger input (1-2)
+
+        On the trigger edge the firmware moves the servo to its open/closed
+        position, either immediately or as a stepped ramp using the current
+        step settings. mode=None unbinds the servo. Settings are copied at
+        call time, so re-run this after changing them.
+        """
+        if not self._connected:
+            print("Device not connected")
+            return False
+        if not 1 <= trigger <= self.TRIGGER_COUNT:
+            print(f"Invalid trigger: {trigger}")
+            return False
+        if mode not in self.TRIGGER_MODES:
+            print(f"Invalid trigger mode: {mode}")
+            return False
+
+        targets = self._resolve_targets(action, [ax])
+        if not targets:
+            return False
+        ax, hw_idx, settings, pw = targets[0]
+
+        step_pw = self._step_pw(settings)
+        delay_ms = settings["step_delay_ms"]
+        data = bytes(
+            [
+                trigger - 1,
+                hw_idx,
+                self.TRIGGER_MODES[mode],
+                (pw >> 8) & 0xFF,
+                pw & 0xFF,
+                (step_pw >> 8) & 0xFF,
+                step_pw & 0xFF,
+                (delay_ms >> 8) & 0xFF,
+                delay_ms & 0xFF,
+            ]
+        )
+        pkt = self._transact(self.CMD_CONFIG_TRIGGER, data)
+        if not pkt or pkt["data"][0] != self.RESP_OK:
+            print(f"Error configuring trigger {trigger} for servo {ax}")
+            return False
+        return True
+
+    @remote
+    def arm_trigger(self, trigger, edge="rising"):
+        """Arm trigger input (1-2) on 'rising', 'falling' or 'both' edges; clears its count"""
+        if not self._connected:
+            print("Device not connected")
+            return False
+        if not 1 <= trigger <= self.TRIGGER_COUNT or edge not in self.TRIGGER_EDGES:
+            print(f"Invalid trigger/edge: {trigger}/{edge}")
+            return False
+
+        data = bytes([trigger - 1, self.TRIGGER_EDGES[edge]])
+        pkt = self._transact(self.CMD_ARM_TRIGGER, data)
+        if not pkt or pkt["data"][0] != self.RESP_OK:
+            print(f"Error arming trigger {trigger}")
+            return False
+        return True
+
+    @remote
+    def disarm_trigger(self, trigger):
+        return self.arm_trigger(trigger, "off")
+
+    @remote
+    def trigger_status(self):
+        """Returns {trigger: {"edge": ..., "count": ...}} for all trigger inputs"""
+        if not self._connected:
+            return {}
+
+        pkt = self._transact(self.CMD_GET_TRIGGER_STATUS, b"")
+        if (
+            not pkt
+            or pkt["cmd"] != self.CMD_GET_TRIGGER_STATUS
+            or pkt["length"] != 5 * self.TRIGGER_COUNT
+        ):
+            print("Error reading trigger status")
+            return {}
+
+        edges = {v: k for k, v in self.TRIGGER_EDGES.items()}
+        result = {}
+        for t in range(self.TRIGGER_COUNT):
+            d = pkt["data"][t * 5 : t * 5 + 5]
+            result[t + 1] = {
+                "edge": edges.get(d[0], "off"),
+                "count": int.from_bytes(d[1:5], "big"),
+            }
+        return result
+
+    @remote
+    def firmware_stats(self, reset=False):
+        """Loop period, motion ISR latency and bad-frame counters kept by the firmware
+
+        reset=True starts a new measurement window after reading. The last
+        result is also reported in get_metrics()["firmware"].
+        """
+        if not self._connected:
+            return {}
+
+        pkt = self._transact(self.CMD_GET_STATS, bytes([1 if reset else 0]))
+        count = len(self.FIRMWARE_STATS_FIELDS)
+        if not pkt or pkt["cmd"] != self.CMD_GET_STATS or pkt["length"] != 2 * count + 1:
+            print("Error reading firmware stats (firmware without CMD_GET_STATS?)")
+            return {}
+
+        data = pkt["data"]
+        stats = {
+            name: (data[i * 2] << 8) | data[i * 2 + 1]
+            for i, name in enumerate(self.FIRMWARE_STATS_FIELDS)
+        }
+        stats["rx_ring_high_water"] = data[2 * count]
+        self._firmware_stats = stats
+        return stats
+
+    def _metrics_snapshot(self):
+        snapshot = super()._metrics_snapshot()
+        if self._firmware_stats is not None:
+            snapshot["firmware"] = dict(self._firmware_stats)
+        return snapshot
 
     @remote
     def update_settings(self, servo_idx, **kwargs):
+        changed = False
         for key, value in kwargs.items():
             if key in self.servo_settings[servo_idx]:
+                changed |= key in self.CONFIG_KEYS and self.servo_settings[servo_idx][key] != value
                 self.servo_settings[servo_idx][key] = value
+        if changed:
+            self._config_dirty.add(servo_idx)
+            if self._onboard_config and self._connected:
+                self._push_config(servo_idx)
         print(f"Updated settings for servo {servo_idx}: {kwargs}")
 
+    @remote
+    def save_settings(self, restore_defaults=False):
+        """Store the controller's current servo settings in its flash (refused while servos move)
+
+        restore_defaults: reset all servos to the firmware defaults first"""
+        if not self._connected or not self._onboard_config:
+            print("Controller cannot store settings")
+            return False
+        pkt = self._transact(self.CMD_SAVE_CONFIG, bytes([1 if restore_defaults else 0]))
+        if not pkt or pkt["data"][0] != self.RESP_OK:
+            print("Error saving settings (servos still moving?)")
+            return False
+        if restore_defaults:
+            self._config_dirty.clear()
+            self._load_onboard_config()
+        print("Servo settings saved to the controller")
+        return True
+
     @remote
     def get_settings(self, servo_idx):
         return self.servo_settings[servo_idx].copy()
@@ -451,9 +1290,14 @@ class ShutterWorker(DeviceWorker):
 
 @include_remote_methods(ShutterWorker)
 class Shutter(DeviceOverZeroMQ):
-    def __init__(self, *args, use_stepped=True, **kwargs):
+    def __init__(self, *args, use_stepped=True, max_ui_rate=20.0, **kwargs):
+        """max_ui_rate: dock repaints per second at most; status messages in between are merged"""
         super().__init__(*args, **kwargs)
         self.use_stepped = use_stepped
+        self._max_ui_rate = float(max_ui_rate)
+        self._status_throttle = None
+        # Widget setters skip values that are already on screen
+        self._render = RenderCache()
 
     def _generate_func(self, number):
         def change_state(on):
@@ -471,39 +1315,42 @@ class Shutter(DeviceOverZeroMQ):
         return change_state
 
     def update_ui(self, status):
-        if self.get_connected():
-            # Only update configured servos
-            pins = self.get_pins()
-            for idx, pin in enumerate(pins):
-                try:
-                    switch = self.buttons[pin]
-                    switch.setEnabled(True)
-
-                    state_key = f"open{pin}"
-                    if state_key in status:
-                        # Block signal so programmatic update doesn't re-trigger move
-                        switch.blockSignals(True)
-                        switch.setChecked(status[state_key])
-                        switch.blockSignals(False)
-
-                    # Update label with custom name
-                    settings = self.get_settings(idx)
-                    name = settings.get("name", f"Servo {pin}")
-                    if pin in self.button_labels:
-                        self.button_labels[pin].setText(name)
-                except Exception as e:
-                    print(f"Error updating status for pin {pin}: {e}")
-        else:
-            # Disable all configured servo switches
-            pins = self.get_pins()
-            for idx, pin in enumerate(pins):
+        """Listener slot; every message is merged, the dock is rendered at most max_ui_rate times per second"""
+        self._status_throttle.push(status)
+
+    def _render_status(self, status, changed):
+        connected = bool(status.get("serial_connected"))
+        if changed.get("serial_connected") and connected:
+            # Names may have been edited by another client while the controller was away
+            self._refresh_labels()
+        for pin in self._pins:
+            try:
                 switch = self.buttons[pin]
+                self._render.set(switch, "setEnabled", connected)
+
+                state_key = f"open{pin}"
+                if connected and state_key in changed:
+                    checked = status[state_key]
+                elif not connected and "serial_connected" in changed:
+                    checked = False
+                else:
+                    continue
+                # Block signal so programmatic update doesn't re-trigger move
                 switch.blockSignals(True)
-                switch.setChecked(False)
+                switch.setChecked(checked)
                 switch.blockSignals(False)
-                switch.setEnabled(False)
+            except Exception as e:
+                print(f"Error updating status for pin {pin}: {e}")
+        if not connected and "serial_connected" in changed:
+            for pin in self._pins:
                 if pin in self.button_labels:
-                    self.button_labels[pin].setText(f"Servo {pin}")
+                    self._render.set(self.button_labels[pin], "setText", f"Servo {pin}")
+
+    def _refresh_labels(self):
+        for idx, pin in enumerate(self._pins):
+            settings = self.get_settings(idx)
+            if pin in self.button_labels:
+                self._render.set(self.button_labels[pin], "setText", settings.get("name", f"Servo {pin}"))
 
     def _update_settings_from_ui(self):
         """Update settings from UI controls"""
@@ -515,6 +1362,8 @@ class Shutter(DeviceOverZeroMQ):
             open_pw = int(self.open_pw_spinbox.value())
             step_deg = float(self.step_deg_spinbox.value())
             step_delay = int(self.step_delay_spinbox.value())
+            profile = self.profile_combo.currentData()
+            preset = int(self.preset_spinbox.value())
             name = self.name_input.text().strip()
 
             if not name:
@@ -526,15 +1375,23 @@ class Shutter(DeviceOverZeroMQ):
                 open_pw=open_pw,
                 step_deg=step_deg,
                 step_delay_ms=step_delay,
+                profile=profile,
+                preset=preset,
                 name=name,
             )
 
             # Update the label text in control tab
             if pin in self.button_labels:
-                self.button_labels[pin].setText(name)
+                self._render.set(self.button_labels[pin], "setText", name)
         except Exception as e:
             print(f"Error updating settings: {e}")
 
+    def _save_settings_from_ui(self):
+        try:
+            self.save_settings()
+        except Exception as e:
+            print(f"Error saving settings: {e}")
+
     def _load_settings_to_ui(self):
         """Load current settings into UI"""
         try:
@@ -546,6 +1403,9 @@ class Shutter(DeviceOverZeroMQ):
             self.open_pw_spinbox.setValue(settings["open_pw"])
             self.step_deg_spinbox.setValue(settings["step_deg"])
             self.step_delay_spinbox.setValue(settings["step_delay_ms"])
+            profile_idx = self.profile_combo.findData(settings.get("profile", "linear"))
+            self.profile_combo.setCurrentIndex(max(profile_idx, 0))
+            self.preset_spinbox.setValue(settings.get("preset", 1))
             self.name_input.setText(settings.get("name", f"Servo {pin}"))
 
             # Update radio button selection
@@ -589,6 +1449,7 @@ class Shutter(DeviceOverZeroMQ):
         # Calculate grid dimensions (prefer 2 columns)
         servo_count = self.get_servo_count()
         pins = self.get_pins()
+        self._pins = pins
         n_cols = min(2, servo_count)
         n_rows = (servo_count + n_cols - 1) // n_cols
 
@@ -712,6 +1573,20 @@ class Shutter(DeviceOverZeroMQ):
         self.step_delay_spinbox.setSuffix(" ms")
         form_layout.addWidget(self.step_delay_spinbox, 2, 3)
 
+        # Row 3: Motion profile (step settings only apply to "Linear")
+        form_layout.addWidget(QtWidgets.QLabel("Profile:"), 3, 0)
+        self.profile_combo = QtWidgets.QComboBox()
+        self.profile_combo.addItem("Linear", "linear")
+        self.profile_combo.addItem("Trapezoid", "trapezoid")
+        self.profile_combo.addItem("S-curve", "scurve")
+        form_layout.addWidget(self.profile_combo, 3, 1)
+
+        form_layout.addWidget(QtWidgets.QLabel("Preset:"), 3, 2)
+        self.preset_spinbox = QtWidgets.QSpinBox()
+        self.preset_spinbox.setRange(0, 3)
+        self.preset_spinbox.setToolTip("0 gentle, 1 normal, 2 fast, 3 servo-limited")
+        form_layout.addWidget(self.preset_spinbox, 3, 3)
+
         # Set column stretches for form
         form_layout.setColumnStretch(0, 0)
         form_layout.setColumnStretch(1, 1)
@@ -745,6 +1620,12 @@ class Shutter(DeviceOverZeroMQ):
         apply_btn.clicked.connect(self._update_settings_from_ui)
         settings_layout.addWidget(apply_btn, 1)  # Stretch factor 1
 
+        # Every save erases a flash page, so it is a separate, explicit action
+        save_btn = QtWidgets.QPushButton("Save to Controller")
+        save_btn.setToolTip("Store the applied settings of all servos in the controller's flash")
+        save_btn.clicked.connect(self._save_settings_from_ui)
+        settings_layout.addWidget(save_btn)
+
         settings_layout.addStretch(0)  # Minimal stretch to push content up
         tabs.addTab(settings_widget, "Settings")
 
@@ -762,4 +1643,8 @@ class Shutter(DeviceOverZeroMQ):
         if menu:
             menu.addAction(self.dock.toggleViewAction())
 
+        self._ui_timer = QtCore.QTimer(self.dock)
+        self._ui_timer.setSingleShot(True)
+        self._status_throttle = StatusThrottle(self._render_status, self._ui_timer, self._max_ui_rate)
+        self._ui_timer.timeout.connect(self._status_throttle.flush)
         self.createListenerThread(self.update_ui)
@@ -1,4 +1,5 @@
 #include <Servo.h>
+#include <EEPROM.h>  // STM32duino flash-emulated EEPROM, incl. the buffered API
 
 // ============================================================================
 // CONFIGURATION
@@ -9,15 +10,79 @@ const uint8_t SERVO_PINS[4] = {9, 1, 0, 10};
 const uint16_t PW_MIN = 500;
 const uint16_t PW_MAX = 2500;
 const uint16_t PW_DEFAULT = 1500;
-uint16_t servo_positions[4] = {PW_DEFAULT, PW_DEFAULT, PW_DEFAULT, PW_DEFAULT};
+
+// Angles travel on the wire in 1/100 degree. 0-180 deg maps onto PW_MIN-PW_MAX
+// at a whole number of deg100 per microsecond, so both directions are a
+// single integer multiply or divide by a compile-time constant.
+constexpr uint16_t DEG100_MAX = 18000;
+constexpr uint16_t DEG100_PER_US = DEG100_MAX / (PW_MAX - PW_MIN);
+static_assert(DEG100_PER_US * (PW_MAX - PW_MIN) == DEG100_MAX,
+              "pulse width span must divide the angle range evenly");
+volatile uint16_t servo_positions[4] = {PW_DEFAULT, PW_DEFAULT, PW_DEFAULT, PW_DEFAULT};
+
+// Stepped moves are advanced from a hardware timer interrupt so serial
+// traffic in loop() can never delay a servo update.
+#ifndef MOTION_TIMER
+#define MOTION_TIMER TIM2
+#endif
+const uint32_t MOTION_TICK_US = 50;
+const bool IDLE_SLEEP = true;  // sleep in loop() until the next interrupt
+
+// TTL inputs that fire preloaded servo moves directly from their ISR
+const uint8_t TRIGGER_COUNT = 2;
+const uint8_t TRIGGER_PINS[TRIGGER_COUNT] = {2, 3};
+
+// ============================================================================
+// MOTION PROFILES
+// ============================================================================
+
+const uint8_t PROFILE_LINEAR = 0;     // fixed step size and delay
+const uint8_t PROFILE_TRAPEZOID = 1;  // time-optimal under velocity/accel limits
+const uint8_t PROFILE_SCURVE = 2;     // minimum-jerk, table driven
+
+// Limits in pulse-width microseconds per second (2000 us = 180 deg)
+struct MotionPreset {
+  uint32_t max_velocity;
+  uint32_t max_accel;
+};
+
+const MotionPreset MOTION_PRESETS[] = {
+  {2000, 10000},     // 0: gentle
+  {5000, 50000},     // 1: normal
+  {10000, 200000},   // 2: fast
+  {20000, 800000},   // 3: limited by the servo itself
+};
+const uint8_t MOTION_PRESET_COUNT = sizeof(MOTION_PRESETS) / sizeof(MOTION_PRESETS[0]);
+
+// Minimum-jerk position 10t^3 - 15t^4 + 6t^5 over normalised time, Q16.
+// Peak velocity is 1.875 D/T and peak acceleration 5.774 D/T^2.
+const uint8_t SCURVE_SEGMENTS = 64;
+const uint16_t SCURVE_TABLE[SCURVE_SEGMENTS + 1] = {
+  0, 2, 19, 63, 145, 277, 467, 723,
+  1052, 1460, 1951, 2529, 3196, 3955, 4806, 5749,
+  6784, 7909, 9121, 10418, 11797, 13253, 14781, 16377,
+  18036, 19750, 21515, 23323, 25167, 27041, 28938, 30849,
+  32768, 34686, 36597, 38494, 40368, 42212, 44020, 45785,
+  47499, 49158, 50754, 52282, 53738, 55117, 56414, 57626,
+  58751, 59786, 60729, 61580, 62339, 63006, 63584, 64075,
+  64483, 64812, 65068, 65258, 65390, 65472, 65516, 65533,
+  65535,
+};
 
 // ============================================================================
 // PROTOCOL CONSTANTS
 // ============================================================================
 
+// Protocol v2 adds frames starting with PKT_START_SEQ that carry a sequence
+// byte after the length; replies echo it. v1 frames are still accepted and
+// answered in v1 framing. The version is reported in the CMD_PING reply.
+const uint8_t PROTOCOL_VERSION = 2;
 const uint8_t PKT_START = 0xAA;
+const uint8_t PKT_START_SEQ = 0xAB;
 const uint8_t PKT_END = 0x55;
 const uint8_t MAX_PACKET_SIZE = 32;
+const uint8_t RX_RING_SIZE = 128;  // must be a power of two
+const uint32_t PKT_BYTE_TIMEOUT_MS = 100;
 
 const uint8_t CMD_PING = 0x01;
 const uint8_t CMD_SET_SERVO = 0x02;
@@ -26,6 +91,49 @@ const uint8_t CMD_GET_ALL = 0x04;
 const uint8_t CMD_MOVE_STEPPED = 0x05;
 const uint8_t CMD_STOP_MOVE = 0x06;
 const uint8_t CMD_GET_MOVE_STATUS = 0x07;
+const uint8_t CMD_SET_MANY = 0x08;
+const uint8_t CMD_MOVE_STEPPED_MANY = 0x09;
+const uint8_t CMD_SUBSCRIBE = 0x0A;
+const uint8_t CMD_STATUS_PUSH = 0x0B;  // unsolicited, device -> host only
+const uint8_t CMD_CONFIG_TRIGGER = 0x0C;
+const uint8_t CMD_ARM_TRIGGER = 0x0D;
+const uint8_t CMD_GET_TRIGGER_STATUS = 0x0E;
+const uint8_t CMD_MOVE_PROFILE = 0x0F;
+const uint8_t CMD_SEQ_UPLOAD = 0x10;
+const uint8_t CMD_SEQ_CONTROL = 0x11;
+const uint8_t CMD_SEQ_STATUS = 0x12;
+const uint8_t CMD_GET_STATS = 0x13;
+const uint8_t CMD_SET_CONFIG = 0x14;
+const uint8_t CMD_GET_CONFIG = 0x15;
+const uint8_t CMD_SAVE_CONFIG = 0x16;
+const uint8_t CMD_MOVE_PRESET = 0x17;
+
+// CMD_MOVE_PRESET flags
+const uint8_t PRESET_OPEN = 0x01;     // open position, otherwise closed
+const uint8_t PRESET_STEPPED = 0x02;  // stored motion profile, otherwise immediate
+
+const uint8_t CONFIG_RECORD_SIZE = 8;
+const uint8_t CONFIG_MAGIC = 0xC5;
+const uint8_t CONFIG_LAYOUT_VERSION = 1;
+const uint8_t CONFIG_RESTORE_DEFAULTS = 1;
+
+const uint8_t MAX_SEQUENCE_ENTRIES = 64;
+const uint8_t SEQ_ENTRY_SIZE = 9;
+const uint8_t SEQ_NO_SERVO = 0xFF;   // entry that only waits
+const uint8_t SEQ_IMMEDIATE = 0;     // entry profile: jump straight to target
+const uint8_t SEQ_STOP = 0;
+const uint8_t SEQ_START = 1;
+
+const uint8_t TRIGGER_ACTION_NONE = 0;
+const uint8_t TRIGGER_ACTION_IMMEDIATE = 1;
+const uint8_t TRIGGER_ACTION_STEPPED = 2;
+
+const uint8_t TRIGGER_EDGE_OFF = 0;
+const uint8_t TRIGGER_EDGE_RISING = 1;
+const uint8_t TRIGGER_EDGE_FALLING = 2;
+const uint8_t TRIGGER_EDGE_BOTH = 3;
+
+const uint32_t STREAM_MIN_INTERVAL_MS = 5;
 
 const uint8_t RESP_OK = 0x00;
 const uint8_t RESP_ERROR = 0xFF;
@@ -39,34 +147,198 @@ struct Packet {
   uint8_t data[MAX_PACKET_SIZE];
   uint8_t length;
   bool valid;
+  bool has_seq;
+  uint8_t seq;
 };
 
 struct SteppedMove {
   bool active;
+  uint8_t profile;
   uint8_t servo_idx;
   uint16_t target_pw;
   uint16_t current_pw;
+  // PROFILE_LINEAR
   uint16_t step_size_pw;
-  uint32_t step_delay_ms;
-  uint32_t last_step_time;
+  uint32_t step_interval_us;
+  uint32_t next_step_us;
+  // PROFILE_TRAPEZOID / PROFILE_SCURVE, precomputed when the move starts
+  uint16_t start_pw;
+  uint16_t distance_pw;
+  uint32_t start_us;
+  uint32_t duration_us;
+  uint32_t accel_us;     // length of the accel (and decel) phase
+  uint32_t accel_pw;     // distance covered while accelerating
+  uint32_t inv_accel_q32;     // 2^32 / accel_us
+  uint64_t velocity_q32;      // peak velocity in pw/us, Q32
+  uint32_t inv_duration_q32;  // 2^32 / duration_us
+};
+
+volatile SteppedMove stepped_moves[4];
+
+// Profiled sequence steps that came due in the motion ISR. The main loop
+// plans them, which keeps the divisions and square roots out of the ISR.
+struct PendingPlan {
+  bool due;
+  uint16_t target_pw;
+  uint8_t profile;
+  uint8_t preset;
+};
+
+volatile PendingPlan pending_plans[4];
+
+struct StatusStream {
+  bool enabled;
+  uint16_t heartbeat_ms;  // 0 = push on change only
+  uint32_t last_push_time;
+  uint8_t last_active_mask;
+  uint16_t last_positions[4];
+  uint8_t last_seq_index;
+  uint16_t last_seq_loops;
+};
+
+StatusStream status_stream = {false, 0, 0, 0, {0, 0, 0, 0}, 0, 0};
+
+struct TriggerAction {
+  uint8_t mode;
+  uint16_t target_pw;
+  uint16_t step_pw;
+  uint32_t interval_us;
+};
+
+struct Trigger {
+  uint8_t edge;
+  uint32_t count;
+  TriggerAction actions[4];
+};
+
+volatile Trigger triggers[TRIGGER_COUNT];
+
+// Host-free choreography: each entry waits delay_us after the previous one,
+// then moves one servo. Scheduled from the motion ISR; profiled steps are
+// planned by the main loop.
+struct SequenceEntry {
+  uint8_t servo_idx;
+  uint16_t target_pw;
+  uint8_t profile;   // SEQ_IMMEDIATE, PROFILE_TRAPEZOID or PROFILE_SCURVE
+  uint8_t preset;
+  uint32_t delay_us;
 };
 
-SteppedMove stepped_moves[4];
+struct SequenceRunner {
+  bool running;
+  uint8_t length;
+  uint8_t index;
+  uint16_t loops;       // 0 = repeat until stopped
+  uint16_t loops_done;
+  uint32_t next_us;
+};
+
+SequenceEntry sequence[MAX_SEQUENCE_ENTRIES];
+volatile SequenceRunner sequence_runner = {false, 0, 0, 0, 0, 0};
+
+HardwareTimer* motion_timer = nullptr;
+volatile uint32_t motion_clock_us = 0;  // advanced by MOTION_TICK_US per tick
+
+enum ParserState : uint8_t {
+  WAIT_START,
+  READ_LENGTH,
+  READ_SEQ,
+  READ_CMD,
+  READ_DATA,
+  READ_CHECKSUM,
+  READ_END
+};
+
+struct PacketParser {
+  ParserState state;
+  bool has_seq;
+  uint8_t length;
+  uint8_t seq;
+  uint8_t cmd;
+  uint8_t data[MAX_PACKET_SIZE];
+  uint8_t data_idx;
+  uint8_t checksum;
+  uint32_t last_byte_time;
+};
+
+PacketParser parser = {WAIT_START, false, 0, 0, 0, {0}, 0, 0, 0};
+
+// Sequence byte of the request being handled; replies sent while it is
+// non-negative use v2 framing. Unsolicited frames are always v1.
+int16_t reply_seq = -1;
+
+uint8_t rx_ring[RX_RING_SIZE];
+uint8_t rx_head = 0;
+uint8_t rx_tail = 0;
+
+// Runtime counters reported by CMD_GET_STATS. Sums are halved together with
+// their counts before they can overflow, so averages stay valid indefinitely.
+struct LoopStats {
+  uint32_t last_us;
+  uint32_t period_sum_us;
+  uint32_t period_count;
+  uint32_t period_max_us;
+  uint16_t frames_dropped;   // partial frames abandoned after PKT_BYTE_TIMEOUT_MS
+  uint16_t frames_invalid;   // bad length, checksum or end marker
+  uint16_t frames_handled;
+  uint8_t ring_high_water;
+};
+
+struct IsrStats {
+  uint32_t latency_sum_us;
+  uint32_t count;
+  uint16_t latency_max_us;
+  uint16_t duration_max_us;
+};
+
+LoopStats loop_stats = {0, 0, 0, 0, 0, 0, 0, 0};
+volatile IsrStats isr_stats = {0, 0, 0, 0};
+
+// Per-servo calibration and motion profile, loaded from flash at boot so
+// open/close needs no parameters on the wire. Record layout (wire and flash):
+// closed pw (2), open pw (2), step in 1/100 deg, step delay in ms (2),
+// profile << 4 | preset. The flash image is magic, layout version, the four
+// records and their XOR.
+struct ServoConfig {
+  uint16_t closed_pw;
+  uint16_t open_pw;
+  uint8_t step_deg_100;
+  uint16_t step_delay_ms;
+  uint8_t profile;
+  uint8_t preset;
+};
+
+const ServoConfig CONFIG_DEFAULT = {900, 1600, 255, 12, PROFILE_LINEAR, 1};
+ServoConfig servo_config[4];
+bool config_from_flash = false;
 
 // ============================================================================
 // HELPER FUNCTIONS
 // ============================================================================
 
-uint16_t degreesToMicroseconds(float degrees) {
-  if (degrees < 0) degrees = 0;
-  if (degrees > 180) degrees = 180;
-  return (uint16_t)(500 + (degrees / 180.0) * 2000);
+uint8_t countServos(uint8_t mask) {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (mask & (1 << i)) n++;
+  }
+  return n;
+}
+
+uint16_t deg100ToMicroseconds(uint16_t deg_100) {
+  if (deg_100 > DEG100_MAX) deg_100 = DEG100_MAX;
+  return PW_MIN + deg_100 / DEG100_PER_US;
+}
+
+uint16_t microsecondsToDeg100(uint16_t microseconds) {
+  if (microseconds < PW_MIN) microseconds = PW_MIN;
+  if (microseconds > PW_MAX) microseconds = PW_MAX;
+  return (microseconds - PW_MIN) * DEG100_PER_US;
 }
 
-float microsecondsToDegrees(uint16_t microseconds) {
-  if (microseconds < 500) microseconds = 500;
-  if (microseconds > 2500) microseconds = 2500;
-  return ((float)(microseconds - 500) / 2000.0) * 180.0;
+// Step sizes are relative, so no PW_MIN offset; never rounds down to zero
+uint16_t stepDeg100ToMicroseconds(uint8_t step_deg_100) {
+  uint16_t step_pw = step_deg_100 / DEG100_PER_US;
+  return step_pw ? step_pw : 1;
 }
 
 bool setServoMicroseconds(uint8_t servo_idx, uint16_t microseconds) {
@@ -77,23 +349,254 @@ bool setServoMicroseconds(uint8_t servo_idx, uint16_t microseconds) {
   return true;
 }
 
+void encodeConfig(const ServoConfig& cfg, uint8_t* out) {
+  out[0] = (cfg.closed_pw >> 8) & 0xFF;
+  out[1] = cfg.closed_pw & 0xFF;
+  out[2] = (cfg.open_pw >> 8) & 0xFF;
+  out[3] = cfg.open_pw & 0xFF;
+  out[4] = cfg.step_deg_100;
+  out[5] = (cfg.step_delay_ms >> 8) & 0xFF;
+  out[6] = cfg.step_delay_ms & 0xFF;
+  out[7] = (cfg.profile << 4) | cfg.preset;
+}
+
+// Returns false (leaving cfg untouched) for out of range values
+bool decodeConfig(const uint8_t* in, ServoConfig& cfg) {
+  ServoConfig decoded;
+  decoded.closed_pw = (in[0] << 8) | in[1];
+  decoded.open_pw = (in[2] << 8) | in[3];
+  decoded.step_deg_100 = in[4];
+  decoded.step_delay_ms = (in[5] << 8) | in[6];
+  decoded.profile = in[7] >> 4;
+  decoded.preset = in[7] & 0x0F;
+  if (decoded.closed_pw < PW_MIN || decoded.closed_pw > PW_MAX ||
+      decoded.open_pw < PW_MIN || decoded.open_pw > PW_MAX ||
+      decoded.step_deg_100 == 0 || decoded.profile > PROFILE_SCURVE ||
+      decoded.preset >= MOTION_PRESET_COUNT) {
+    return false;
+  }
+  cfg = decoded;
+  return true;
+}
+
+// One buffered read of the flash page; any invalid record means defaults
+// for all servos, so a half-written or foreign image is never used.
+void loadConfig() {
+  for (uint8_t i = 0; i < 4; i++) servo_config[i] = CONFIG_DEFAULT;
+  config_from_flash = false;
+  
+  eeprom_buffer_fill();
+  if (eeprom_buffered_read_byte(0) != CONFIG_MAGIC ||
+      eeprom_buffered_read_byte(1) != CONFIG_LAYOUT_VERSION) {
+    return;
+  }
+  uint8_t records[4 * CONFIG_RECORD_SIZE];
+  uint8_t checksum = 0;
+  for (uint8_t i = 0; i < sizeof(records); i++) {
+    records[i] = eeprom_buffered_read_byte(2 + i);
+    checksum ^= records[i];
+  }
+  if (checksum != eeprom_buffered_read_byte(2 + sizeof(records))) return;
+  
+  ServoConfig loaded[4];
+  for (uint8_t i = 0; i < 4; i++) {
+    if (!decodeConfig(&records[i * CONFIG_RECORD_SIZE], loaded[i])) return;
+  }
+  for (uint8_t i = 0; i < 4; i++) servo_config[i] = loaded[i];
+  config_from_flash = true;
+}
+
+// Erases and rewrites one flash page. The CPU stalls while the page is
+// erased, motion ISR included, so callers make sure nothing is moving.
+void saveConfig() {
+  uint8_t record[CONFIG_RECORD_SIZE];
+  uint8_t checksum = 0;
+  eeprom_buffered_write_byte(0, CONFIG_MAGIC);
+  eeprom_buffered_write_byte(1, CONFIG_LAYOUT_VERSION);
+  for (uint8_t i = 0; i < 4; i++) {
+    encodeConfig(servo_config[i], record);
+    for (uint8_t j = 0; j < CONFIG_RECORD_SIZE; j++) {
+      eeprom_buffered_write_byte(2 + i * CONFIG_RECORD_SIZE + j, record[j]);
+      checksum ^= record[j];
+    }
+  }
+  eeprom_buffered_write_byte(2 + 4 * CONFIG_RECORD_SIZE, checksum);
+  eeprom_buffer_flush();
+  config_from_flash = true;
+}
+
+// Caller must keep the motion ISR out (interrupts disabled or in an ISR of
+// the same or higher priority).
+void armSteppedMove(uint8_t servo_idx, uint16_t target_pw, uint16_t step_pw,
+                    uint32_t interval_us, uint32_t start_us) {
+  volatile SteppedMove* move = &stepped_moves[servo_idx];
+  move->profile = PROFILE_LINEAR;
+  move->servo_idx = servo_idx;
+  move->target_pw = target_pw;
+  move->current_pw = servo_positions[servo_idx];
+  move->step_size_pw = step_pw;
+  move->step_interval_us = interval_us;
+  move->next_step_us = start_us + interval_us;
+  move->active = true;
+}
+
+uint32_t isqrt64(uint64_t x) {
+  uint64_t result = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+  while (bit > x) bit >>= 2;
+  while (bit != 0) {
+    if (x >= result + bit) {
+      x -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)result;
+}
+
+// Plans a minimum-time move under the preset limits. All divisions and the
+// square roots happen here, once per move, and leave fixed-point reciprocals
+// behind, so profileDistance() in the ISR only multiplies, shifts and looks
+// up the S-curve table. Called from the main loop with interrupts disabled,
+// never from an ISR. Returns the planned duration in us.
+uint32_t armProfiledMove(uint8_t servo_idx, uint16_t target_pw, uint8_t profile,
+                         uint8_t preset, uint32_t start_us) {
+  const MotionPreset& limits = MOTION_PRESETS[preset];
+  volatile SteppedMove* move = &stepped_moves[servo_idx];
+  uint16_t start_pw = servo_positions[servo_idx];
+  uint32_t distance = (target_pw > start_pw) ? target_pw - start_pw : start_pw - target_pw;
+  uint32_t duration_us = 0;
+  
+  if (profile == PROFILE_TRAPEZOID) {
+    uint32_t v = limits.max_velocity;
+    uint32_t a = limits.max_accel;
+    // Not enough distance to reach max_velocity: triangular profile
+    if ((uint64_t)v * v > (uint64_t)distance * a) {
+      v = isqrt64((uint64_t)distance * a);
+    }
+    uint32_t accel_us = v > 0 ? (uint32_t)((uint64_t)v * 1000000 / a) : 0;
+    uint32_t accel_pw = (uint32_t)((uint64_t)v * v / (2 * (uint64_t)a));
+    uint32_t cruise_us = v > 0 ? (uint32_t)((uint64_t)(distance - 2 * accel_pw) * 1000000 / v) : 0;
+    duration_us = 2 * accel_us + cruise_us;
+    move->accel_us = accel_us;
+    move->accel_pw = accel_pw;
+    move->inv_accel_q32 = accel_us > 0 ? (uint32_t)(((uint64_t)1 << 32) / accel_us) : 0;
+    move->velocity_q32 = ((uint64_t)v << 32) / 1000000;
+  } else {
+    uint32_t t_vel = (uint32_t)((uint64_t)distance * 1875000 / limits.max_velocity);
+    uint32_t t_acc = isqrt64((uint64_t)distance * 5774000000000ULL / limits.max_accel);
+    duration_us = (t_vel > t_acc) ? t_vel : t_acc;
+  }
+  
+  move->profile = profile;
+  move->servo_idx = servo_idx;
+  move->target_pw = target_pw;
+  move->current_pw = start_pw;
+  move->start_pw = start_pw;
+  move->distance_pw = distance;
+  move->start_us = start_us;
+  move->duration_us = duration_us;
+  move->inv_duration_q32 = duration_us > 0 ? (uint32_t)(((uint64_t)1 << 32) / duration_us) : 0;
+  move->active = true;
+  return duration_us;
+}
+
+// Distance covered while accelerating for t_us (< accel_us): accel_pw * (t/accel_us)^2
+uint32_t accelDistance(volatile SteppedMove* move, uint32_t t_us) {
+  uint64_t f = ((uint64_t)t_us * move->inv_accel_q32) >> 16;  // Q16, 0..1
+  return (uint32_t)((move->accel_pw * f * f) >> 32);
+}
+
+// Distance travelled after elapsed_us (< duration_us), 0..distance_pw
+uint32_t profileDistance(volatile SteppedMove* move, uint32_t elapsed_us) {
+  if (move->profile == PROFILE_TRAPEZOID) {
+    uint32_t decel_start = move->duration_us - move->accel_us;
+    if (elapsed_us < move->accel_us) {
+      return accelDistance(move, elapsed_us);
+    }
+    if (elapsed_us < decel_start) {
+      return move->accel_pw +
+             (uint32_t)(((elapsed_us - move->accel_us) * move->velocity_q32) >> 32);
+    }
+    uint32_t remaining_pw = accelDistance(move, move->duration_us - elapsed_us);
+    return (remaining_pw < move->distance_pw) ? move->distance_pw - remaining_pw : 0;
+  }
+  
+  // Position in the move as a Q32 fraction, split into table segment and Q16 remainder
+  uint64_t scaled = ((uint64_t)elapsed_us * move->inv_duration_q32) * SCURVE_SEGMENTS;
+  uint32_t idx = (uint32_t)(scaled >> 32);
+  uint32_t frac = (uint32_t)(scaled >> 16) & 0xFFFF;
+  uint32_t lo = SCURVE_TABLE[idx];
+  uint32_t hi = SCURVE_TABLE[idx + 1];
+  uint32_t shape = lo + (((hi - lo) * frac) >> 16);
+  return (uint32_t)(((uint64_t)move->distance_pw * shape) >> 16);
+}
+
+// Called with interrupts enabled from the main loop; the move is published to
+// the motion ISR atomically. Moves started with the same start_us step in
+// lockstep.
+void startSteppedMove(uint8_t servo_idx, uint16_t target_pw, uint16_t step_pw,
+                      uint32_t interval_us, uint32_t start_us) {
+  noInterrupts();
+  armSteppedMove(servo_idx, target_pw, step_pw, interval_us, start_us);
+  interrupts();
+}
+
+// Runs in the EXTI interrupt of trigger t. Interrupts are masked for the
+// few microseconds it takes so the motion ISR never sees a half-written move.
+void fireTrigger(uint8_t t) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  
+  volatile Trigger* trig = &triggers[t];
+  trig->count++;
+  uint32_t start_us = motion_clock_us;
+  
+  for (uint8_t i = 0; i < 4; i++) {
+    volatile TriggerAction* action = &trig->actions[i];
+    if (action->mode == TRIGGER_ACTION_IMMEDIATE) {
+      stepped_moves[i].active = false;
+      setServoMicroseconds(i, action->target_pw);
+    } else if (action->mode == TRIGGER_ACTION_STEPPED) {
+      armSteppedMove(i, action->target_pw, action->step_pw, action->interval_us,
+                     start_us);
+    }
+  }
+  
+  __set_PRIMASK(primask);
+}
+
+void triggerISR0() { fireTrigger(0); }
+void triggerISR1() { fireTrigger(1); }
+
+void (*const TRIGGER_ISRS[TRIGGER_COUNT])() = {triggerISR0, triggerISR1};
+
 // ============================================================================
 // PACKET FUNCTIONS
 // ============================================================================
 
 void sendPacket(uint8_t cmd, uint8_t* data, uint8_t data_len) {
-  uint8_t packet[MAX_PACKET_SIZE + 5];
+  uint8_t packet[MAX_PACKET_SIZE + 6];
   uint8_t idx = 0;
+  uint8_t checksum = data_len ^ cmd;
   
-  packet[idx++] = PKT_START;
-  packet[idx++] = data_len;
+  if (reply_seq >= 0) {
+    packet[idx++] = PKT_START_SEQ;
+    packet[idx++] = data_len;
+    packet[idx++] = (uint8_t)reply_seq;
+    checksum ^= (uint8_t)reply_seq;
+  } else {
+    packet[idx++] = PKT_START;
+    packet[idx++] = data_len;
+  }
   packet[idx++] = cmd;
   
   for (uint8_t i = 0; i < data_len; i++) {
     packet[idx++] = data[i];
   }
   
-  uint8_t checksum = data_len ^ cmd;
   for (uint8_t i = 0; i < data_len; i++) {
     checksum ^= data[i];
   }
@@ -101,7 +604,6 @@ void sendPacket(uint8_t cmd, uint8_t* data, uint8_t data_len) {
   packet[idx++] = PKT_END;
   
   Serial.write(packet, idx);
-  Serial.flush();
 }
 
 void sendResponse(uint8_t response_code) {
@@ -109,61 +611,144 @@ void sendResponse(uint8_t response_code) {
   sendPacket(RESP_OK, data, 1);
 }
 
+// Bytes are moved from the Serial driver into rx_ring on every loop() pass
+// and fed to the parser one at a time, so a partial or corrupted frame never
+// stalls the main loop. A frame that stops mid-way is dropped after
+// PKT_BYTE_TIMEOUT_MS and the parser resyncs on the next PKT_START.
+bool ringFull() {
+  return ((rx_head + 1) & (RX_RING_SIZE - 1)) == rx_tail;
+}
+
+void ringPush(uint8_t byte) {
+  rx_ring[rx_head] = byte;
+  rx_head = (rx_head + 1) & (RX_RING_SIZE - 1);
+}
+
+bool ringPop(uint8_t* byte) {
+  if (rx_tail == rx_head) return false;
+  *byte = rx_ring[rx_tail];
+  rx_tail = (rx_tail + 1) & (RX_RING_SIZE - 1);
+  return true;
+}
+
+void pumpSerial() {
+  while (Serial.available() > 0 && !ringFull()) {
+    ringPush((uint8_t)Serial.read());
+  }
+  uint8_t fill = (rx_head - rx_tail) & (RX_RING_SIZE - 1);
+  if (fill > loop_stats.ring_high_water) loop_stats.ring_high_water = fill;
+}
+
+uint16_t saturate16(uint32_t value) {
+  return value > 0xFFFF ? 0xFFFF : (uint16_t)value;
+}
+
+void countFrame(uint16_t* counter) {
+  if (*counter < 0xFFFF) (*counter)++;
+}
+
+void resetParser() {
+  parser.state = WAIT_START;
+  parser.length = 0;
+  parser.data_idx = 0;
+}
+
+// Starts a new frame if byte is a start marker; used to resync mid-frame.
+bool beginFrame(uint8_t byte) {
+  if (byte != PKT_START && byte != PKT_START_SEQ) return false;
+  parser.has_seq = (byte == PKT_START_SEQ);
+  parser.state = READ_LENGTH;
+  return true;
+}
+
+// Returns true when a complete, valid packet has been assembled in pkt.
+bool parseByte(uint8_t byte, Packet& pkt) {
+  parser.last_byte_time = millis();
+
+  switch (parser.state) {
+    case WAIT_START:
+      beginFrame(byte);
+      return false;
+
+    case READ_LENGTH:
+      if (byte > MAX_PACKET_SIZE) {
+        // A stray start marker inside garbage; the length byte may itself be a start
+        countFrame(&loop_stats.frames_invalid);
+        if (!beginFrame(byte)) resetParser();
+        return false;
+      }
+      parser.length = byte;
+      parser.checksum = byte;
+      parser.state = parser.has_seq ? READ_SEQ : READ_CMD;
+      return false;
+
+    case READ_SEQ:
+      parser.seq = byte;
+      parser.checksum ^= byte;
+      parser.state = READ_CMD;
+      return false;
+
+    case READ_CMD:
+      parser.cmd = byte;
+      parser.checksum ^= byte;
+      parser.data_idx = 0;
+      parser.state = (parser.length > 0) ? READ_DATA : READ_CHECKSUM;
+      return false;
+
+    case READ_DATA:
+      parser.data[parser.data_idx++] = byte;
+      parser.checksum ^= byte;
+      if (parser.data_idx >= parser.length) parser.state = READ_CHECKSUM;
+      return false;
+
+    case READ_CHECKSUM:
+      if (byte != parser.checksum) {
+        countFrame(&loop_stats.frames_invalid);
+        resetParser();
+        beginFrame(byte);
+        return false;
+      }
+      parser.state = READ_END;
+      return false;
+
+    case READ_END:
+      if (byte != PKT_END) {
+        countFrame(&loop_stats.frames_invalid);
+        resetParser();
+        beginFrame(byte);
+        return false;
+      }
+      pkt.valid = true;
+      pkt.has_seq = parser.has_seq;
+      pkt.seq = parser.seq;
+      pkt.cmd = parser.cmd;
+      pkt.length = parser.length;
+      memcpy(pkt.data, parser.data, parser.length);
+      resetParser();
+      return true;
+  }
+
+  resetParser();
+  return false;
+}
+
 Packet receivePacket() {
   Packet pkt;
   pkt.valid = false;
+  pkt.has_seq = false;
   pkt.length = 0;
-  
-  if (Serial.available() < 1) return pkt;
-  
-  uint8_t start = Serial.read();
-  if (start != PKT_START) return pkt;
-  
-  unsigned long timeout = millis() + 100;
-  while (Serial.available() < 1 && millis() < timeout);
-  if (Serial.available() < 1) return pkt;
-  
-  uint8_t length = Serial.read();
-  if (length > MAX_PACKET_SIZE) return pkt;
-  
-  timeout = millis() + 100;
-  while (Serial.available() < 1 && millis() < timeout);
-  if (Serial.available() < 1) return pkt;
-  
-  uint8_t cmd = Serial.read();
-  
-  timeout = millis() + 100;
-  while (Serial.available() < length && millis() < timeout);
-  if (Serial.available() < length) return pkt;
-  
-  uint8_t data[MAX_PACKET_SIZE];
-  for (uint8_t i = 0; i < length; i++) {
-    data[i] = Serial.read();
-  }
-  
-  timeout = millis() + 100;
-  while (Serial.available() < 2 && millis() < timeout);
-  if (Serial.available() < 2) return pkt;
-  
-  uint8_t received_checksum = Serial.read();
-  uint8_t end_marker = Serial.read();
-  
-  if (end_marker != PKT_END) return pkt;
-  
-  uint8_t expected_checksum = length ^ cmd;
-  for (uint8_t i = 0; i < length; i++) {
-    expected_checksum ^= data[i];
+
+  if (parser.state != WAIT_START &&
+      millis() - parser.last_byte_time > PKT_BYTE_TIMEOUT_MS) {
+    countFrame(&loop_stats.frames_dropped);
+    resetParser();
   }
-  
-  if (received_checksum != expected_checksum) return pkt;
-  
-  pkt.valid = true;
-  pkt.cmd = cmd;
-  pkt.length = length;
-  for (uint8_t i = 0; i < length; i++) {
-    pkt.data[i] = data[i];
+
+  uint8_t byte;
+  while (ringPop(&byte)) {
+    if (parseByte(byte, pkt)) break;
   }
-  
+
   return pkt;
 }
 
@@ -172,8 +757,8 @@ Packet receivePacket() {
 // ============================================================================
 
 void handlePing(Packet& pkt) {
-  uint8_t response[4] = {0x50, 0x4F, 0x4E, 0x47};
-  sendPacket(CMD_PING, response, 4);
+  uint8_t response[5] = {0x50, 0x4F, 0x4E, 0x47, PROTOCOL_VERSION};
+  sendPacket(CMD_PING, response, 5);
 }
 
 void handleSetServo(Packet& pkt) {
@@ -239,23 +824,436 @@ void handleMoveStep(Packet& pkt) {
   uint8_t step_deg_100 = pkt.data[3];
   uint16_t delay_ms = (pkt.data[4] << 8) | pkt.data[5];
   
-  float target_degrees = target_deg_100 / 100.0;
-  float step_degrees = step_deg_100 / 100.0;
+  uint16_t target_pw = deg100ToMicroseconds(target_deg_100);
+  uint16_t step_pw = stepDeg100ToMicroseconds(step_deg_100);
   
-  uint16_t target_pw = degreesToMicroseconds(target_degrees);
-  float pw_per_degree = 2000.0 / 180.0;
-  uint16_t step_pw = (uint16_t)(step_degrees * pw_per_degree);
+  startSteppedMove(servo_idx, target_pw, step_pw, (uint32_t)delay_ms * 1000,
+                   motion_clock_us);
   
+  sendResponse(RESP_OK);
+}
+
+// Payload: servo bitmask, then a 2-byte pulse width for each set bit in
+// ascending servo order. All targets are validated before any is applied.
+void handleSetMany(Packet& pkt) {
+  uint8_t mask = pkt.length > 0 ? pkt.data[0] : 0;
+  uint8_t count = countServos(mask);
+  if (mask == 0 || mask > 0x0F || pkt.length != 1 + 2 * count) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  uint16_t targets[4];
+  uint8_t offset = 1;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (!(mask & (1 << i))) continue;
+    targets[i] = (pkt.data[offset] << 8) | pkt.data[offset + 1];
+    offset += 2;
+    if (targets[i] < PW_MIN || targets[i] > PW_MAX) {
+      sendResponse(RESP_ERROR);
+      return;
+    }
+  }
+  
+  noInterrupts();
+  for (uint8_t i = 0; i < 4; i++) {
+    if (mask & (1 << i)) setServoMicroseconds(i, targets[i]);
+  }
+  interrupts();
+  
+  sendResponse(RESP_OK);
+}
+
+// Payload: servo bitmask, then for each set bit in ascending servo order the
+// same 5 bytes as CMD_MOVE_STEPPED (target, step, delay). All moves share one
+// start time.
+void handleMoveSteppedMany(Packet& pkt) {
+  uint8_t mask = pkt.length > 0 ? pkt.data[0] : 0;
+  uint8_t count = countServos(mask);
+  if (mask == 0 || mask > 0x0F || pkt.length != 1 + 5 * count) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  uint32_t start_us = motion_clock_us;
+  uint8_t offset = 1;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (!(mask & (1 << i))) continue;
+    
+    uint16_t target_deg_100 = (pkt.data[offset] << 8) | pkt.data[offset + 1];
+    uint8_t step_deg_100 = pkt.data[offset + 2];
+    uint16_t delay_ms = (pkt.data[offset + 3] << 8) | pkt.data[offset + 4];
+    offset += 5;
+    
+    uint16_t target_pw = deg100ToMicroseconds(target_deg_100);
+    uint16_t step_pw = stepDeg100ToMicroseconds(step_deg_100);
+    
+    startSteppedMove(i, target_pw, step_pw, (uint32_t)delay_ms * 1000, start_us);
+  }
+  
+  sendResponse(RESP_OK);
+}
+
+// Payload: enable flag, 2-byte heartbeat in ms. While enabled the device
+// pushes CMD_STATUS_PUSH frames whenever a position or move state changes,
+// and at least once per heartbeat otherwise.
+void handleSubscribe(Packet& pkt) {
+  if (pkt.length != 3) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  status_stream.enabled = pkt.data[0] != 0;
+  status_stream.heartbeat_ms = (pkt.data[1] << 8) | pkt.data[2];
+  status_stream.last_push_time = millis() - status_stream.heartbeat_ms;
+  status_stream.last_active_mask = 0xFF;  // force an initial push
+  
+  sendResponse(RESP_OK);
+}
+
+// Payload: trigger, servo, action mode, target pw (2), step pw (2),
+// step delay ms (2). Mode TRIGGER_ACTION_NONE unbinds the servo.
+void handleConfigTrigger(Packet& pkt) {
+  if (pkt.length != 9) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  uint8_t t = pkt.data[0];
+  uint8_t servo_idx = pkt.data[1];
+  uint8_t mode = pkt.data[2];
+  uint16_t target_pw = (pkt.data[3] << 8) | pkt.data[4];
+  uint16_t step_pw = (pkt.data[5] << 8) | pkt.data[6];
+  uint16_t delay_ms = (pkt.data[7] << 8) | pkt.data[8];
+  
+  if (t >= TRIGGER_COUNT || servo_idx > 3 || mode > TRIGGER_ACTION_STEPPED ||
+      (mode != TRIGGER_ACTION_NONE && (target_pw < PW_MIN || target_pw > PW_MAX))) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
   if (step_pw == 0) step_pw = 1;
   
-  SteppedMove* move = &stepped_moves[servo_idx];
-  move->active = true;
-  move->servo_idx = servo_idx;
-  move->target_pw = target_pw;
-  move->current_pw = servo_positions[servo_idx];
-  move->step_size_pw = step_pw;
-  move->step_delay_ms = delay_ms;
-  move->last_step_time = millis();
+  noInterrupts();
+  volatile TriggerAction* action = &triggers[t].actions[servo_idx];
+  action->mode = mode;
+  action->target_pw = target_pw;
+  action->step_pw = step_pw;
+  action->interval_us = (uint32_t)delay_ms * 1000;
+  interrupts();
+  
+  sendResponse(RESP_OK);
+}
+
+// Payload: trigger, edge (TRIGGER_EDGE_OFF disarms). Arming clears the count.
+void handleArmTrigger(Packet& pkt) {
+  if (pkt.length != 2 || pkt.data[0] >= TRIGGER_COUNT ||
+      pkt.data[1] > TRIGGER_EDGE_BOTH) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  uint8_t t = pkt.data[0];
+  uint8_t edge = pkt.data[1];
+  uint8_t pin = TRIGGER_PINS[t];
+  
+  detachInterrupt(digitalPinToInterrupt(pin));
+  triggers[t].edge = edge;
+  
+  if (edge != TRIGGER_EDGE_OFF) {
+    triggers[t].count = 0;
+    uint32_t mode = (edge == TRIGGER_EDGE_RISING) ? RISING :
+                    (edge == TRIGGER_EDGE_FALLING) ? FALLING : CHANGE;
+    attachInterrupt(digitalPinToInterrupt(pin), TRIGGER_ISRS[t], mode);
+  }
+  
+  sendResponse(RESP_OK);
+}
+
+// Reply: per trigger, edge (1) and 32-bit fire count.
+void handleGetTriggerStatus(Packet& pkt) {
+  uint8_t response[TRIGGER_COUNT * 5];
+  
+  for (uint8_t t = 0; t < TRIGGER_COUNT; t++) {
+    uint32_t count = triggers[t].count;
+    response[t*5] = triggers[t].edge;
+    response[t*5 + 1] = (count >> 24) & 0xFF;
+    response[t*5 + 2] = (count >> 16) & 0xFF;
+    response[t*5 + 3] = (count >> 8) & 0xFF;
+    response[t*5 + 4] = count & 0xFF;
+  }
+  
+  sendPacket(CMD_GET_TRIGGER_STATUS, response, TRIGGER_COUNT * 5);
+}
+
+// Payload: servo bitmask, then for each set bit in ascending servo order
+// target pw (2), profile (1), preset (1). All moves share one start time.
+// Reply: ACK followed by the longest planned duration in ms.
+void handleMoveProfile(Packet& pkt) {
+  uint8_t mask = pkt.length > 0 ? pkt.data[0] : 0;
+  uint8_t count = countServos(mask);
+  if (mask == 0 || mask > 0x0F || pkt.length != 1 + 4 * count) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  uint8_t offset = 1;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (!(mask & (1 << i))) continue;
+    uint16_t target_pw = (pkt.data[offset] << 8) | pkt.data[offset + 1];
+    uint8_t profile = pkt.data[offset + 2];
+    uint8_t preset = pkt.data[offset + 3];
+    offset += 4;
+    if (target_pw < PW_MIN || target_pw > PW_MAX || preset >= MOTION_PRESET_COUNT ||
+        (profile != PROFILE_TRAPEZOID && profile != PROFILE_SCURVE)) {
+      sendResponse(RESP_ERROR);
+      return;
+    }
+  }
+  
+  uint32_t longest_us = 0;
+  offset = 1;
+  noInterrupts();
+  uint32_t start_us = motion_clock_us;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (!(mask & (1 << i))) continue;
+    uint16_t target_pw = (pkt.data[offset] << 8) | pkt.data[offset + 1];
+    uint32_t duration_us = armProfiledMove(i, target_pw, pkt.data[offset + 2],
+                                           pkt.data[offset + 3], start_us);
+    if (duration_us > longest_us) longest_us = duration_us;
+    offset += 4;
+  }
+  interrupts();
+  
+  uint32_t longest_ms = (longest_us + 999) / 1000;
+  if (longest_ms > 0xFFFF) longest_ms = 0xFFFF;
+  uint8_t response[3] = {RESP_OK, (uint8_t)(longest_ms >> 8), (uint8_t)(longest_ms & 0xFF)};
+  sendPacket(RESP_OK, response, 3);
+}
+
+// Payload: start index, total length, then up to 3 entries of servo (1),
+// target pw (2), profile (1), preset (1), delay us (4). Rejected while a
+// sequence is running.
+void handleSeqUpload(Packet& pkt) {
+  if (pkt.length < 2 || (pkt.length - 2) % SEQ_ENTRY_SIZE != 0 ||
+      sequence_runner.running) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  uint8_t start = pkt.data[0];
+  uint8_t total = pkt.data[1];
+  uint8_t count = (pkt.length - 2) / SEQ_ENTRY_SIZE;
+  if (total > MAX_SEQUENCE_ENTRIES || start + count > total) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  for (uint8_t n = 0; n < count; n++) {
+    const uint8_t* d = &pkt.data[2 + n * SEQ_ENTRY_SIZE];
+    SequenceEntry entry;
+    entry.servo_idx = d[0];
+    entry.target_pw = (d[1] << 8) | d[2];
+    entry.profile = d[3];
+    entry.preset = d[4];
+    entry.delay_us = ((uint32_t)d[5] << 24) | ((uint32_t)d[6] << 16) |
+                     ((uint32_t)d[7] << 8) | d[8];
+    
+    bool valid_servo = entry.servo_idx < 4 || entry.servo_idx == SEQ_NO_SERVO;
+    bool valid_target = entry.servo_idx == SEQ_NO_SERVO ||
+                        (entry.target_pw >= PW_MIN && entry.target_pw <= PW_MAX);
+    bool valid_profile = entry.profile == SEQ_IMMEDIATE ||
+                         ((entry.profile == PROFILE_TRAPEZOID || entry.profile == PROFILE_SCURVE) &&
+                          entry.preset < MOTION_PRESET_COUNT);
+    if (!valid_servo || !valid_target || !valid_profile) {
+      sendResponse(RESP_ERROR);
+      return;
+    }
+    sequence[start + n] = entry;
+  }
+  
+  sequence_runner.length = total;
+  sendResponse(RESP_OK);
+}
+
+// Payload: SEQ_START/SEQ_STOP, loop count (2, 0 = until stopped)
+void handleSeqControl(Packet& pkt) {
+  if (pkt.length != 3) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  if (pkt.data[0] == SEQ_STOP) {
+    noInterrupts();
+    sequence_runner.running = false;
+    for (uint8_t i = 0; i < 4; i++) pending_plans[i].due = false;
+    interrupts();
+    sendResponse(RESP_OK);
+    return;
+  }
+  
+  uint16_t loops = (pkt.data[1] << 8) | pkt.data[2];
+  uint8_t length = sequence_runner.length;
+  uint32_t period_us = 0;
+  for (uint8_t i = 0; i < length; i++) period_us += sequence[i].delay_us;
+  
+  // An endless loop with no delays would starve the motion ISR
+  if (pkt.data[0] != SEQ_START || length == 0 || (loops == 0 && period_us == 0)) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  noInterrupts();
+  sequence_runner.index = 0;
+  sequence_runner.loops = loops;
+  sequence_runner.loops_done = 0;
+  sequence_runner.next_us = motion_clock_us + sequence[0].delay_us;
+  sequence_runner.running = true;
+  interrupts();
+  
+  sendResponse(RESP_OK);
+}
+
+// Reply: running, index, loops done (2), length
+void handleSeqStatus(Packet& pkt) {
+  noInterrupts();
+  uint8_t response[5] = {
+    (uint8_t)(sequence_runner.running ? 1 : 0),
+    sequence_runner.index,
+    (uint8_t)(sequence_runner.loops_done >> 8),
+    (uint8_t)(sequence_runner.loops_done & 0xFF),
+    sequence_runner.length,
+  };
+  interrupts();
+  
+  sendPacket(CMD_SEQ_STATUS, response, 5);
+}
+
+// Reply: loop period avg/max, motion ISR latency avg/max and duration max
+// (2 bytes each, us, saturated), dropped/invalid/handled frames (2 each) and
+// the rx ring high-water mark. A non-zero data byte starts a new window.
+void handleGetStats(Packet& pkt) {
+  if (pkt.length > 1) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  noInterrupts();
+  uint32_t isr_avg = isr_stats.count ? isr_stats.latency_sum_us / isr_stats.count : 0;
+  uint16_t isr_max = isr_stats.latency_max_us;
+  uint16_t isr_duration = isr_stats.duration_max_us;
+  interrupts();
+  uint32_t loop_avg = loop_stats.period_count
+                          ? loop_stats.period_sum_us / loop_stats.period_count
+                          : 0;
+  
+  uint16_t fields[8] = {
+    saturate16(loop_avg),
+    saturate16(loop_stats.period_max_us),
+    saturate16(isr_avg),
+    isr_max,
+    isr_duration,
+    loop_stats.frames_dropped,
+    loop_stats.frames_invalid,
+    loop_stats.frames_handled,
+  };
+  uint8_t response[17];
+  for (uint8_t i = 0; i < 8; i++) {
+    response[i*2] = (fields[i] >> 8) & 0xFF;
+    response[i*2 + 1] = fields[i] & 0xFF;
+  }
+  response[16] = loop_stats.ring_high_water;
+  
+  sendPacket(CMD_GET_STATS, response, 17);
+  
+  if (pkt.length == 1 && pkt.data[0]) {
+    loop_stats = {micros(), 0, 0, 0, 0, 0, 0, 0};
+    noInterrupts();
+    isr_stats.latency_sum_us = 0;
+    isr_stats.count = 0;
+    isr_stats.latency_max_us = 0;
+    isr_stats.duration_max_us = 0;
+    interrupts();
+  }
+}
+
+// Payload: servo index, then one configuration record. Takes effect for the
+// next CMD_MOVE_PRESET; stays in RAM until CMD_SAVE_CONFIG.
+void handleSetConfig(Packet& pkt) {
+  if (pkt.length != 1 + CONFIG_RECORD_SIZE || pkt.data[0] > 3) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  if (decodeConfig(&pkt.data[1], servo_config[pkt.data[0]])) {
+    sendResponse(RESP_OK);
+  } else {
+    sendResponse(RESP_ERROR);
+  }
+}
+
+// Reply: the four configuration records back to back (32 bytes)
+void handleGetConfig(Packet& pkt) {
+  uint8_t response[4 * CONFIG_RECORD_SIZE];
+  for (uint8_t i = 0; i < 4; i++) {
+    encodeConfig(servo_config[i], &response[i * CONFIG_RECORD_SIZE]);
+  }
+  sendPacket(CMD_GET_CONFIG, response, sizeof(response));
+}
+
+// Optional data byte CONFIG_RESTORE_DEFAULTS resets all servos first.
+// Refused while anything moves, since the flash erase stalls the motion ISR.
+void handleSaveConfig(Packet& pkt) {
+  if (pkt.length > 1) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  bool busy = sequence_runner.running;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (stepped_moves[i].active) busy = true;
+  }
+  if (busy) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  if (pkt.length == 1 && pkt.data[0] == CONFIG_RESTORE_DEFAULTS) {
+    for (uint8_t i = 0; i < 4; i++) servo_config[i] = CONFIG_DEFAULT;
+  }
+  saveConfig();
+  sendResponse(RESP_OK);
+}
+
+// Payload: servo bitmask, PRESET_* flags. Moves every servo in the mask to its
+// configured open or closed position, immediately or with its stored motion
+// profile; stepped moves share one start time.
+void handleMovePreset(Packet& pkt) {
+  uint8_t mask = pkt.length > 0 ? pkt.data[0] : 0;
+  if (pkt.length != 2 || mask == 0 || mask > 0x0F) {
+    sendResponse(RESP_ERROR);
+    return;
+  }
+  
+  bool open = pkt.data[1] & PRESET_OPEN;
+  bool stepped = pkt.data[1] & PRESET_STEPPED;
+  
+  noInterrupts();
+  uint32_t start_us = motion_clock_us;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (!(mask & (1 << i))) continue;
+    const ServoConfig& cfg = servo_config[i];
+    uint16_t target_pw = open ? cfg.open_pw : cfg.closed_pw;
+    if (!stepped) {
+      stepped_moves[i].active = false;
+      setServoMicroseconds(i, target_pw);
+    } else if (cfg.profile == PROFILE_LINEAR) {
+      armSteppedMove(i, target_pw, stepDeg100ToMicroseconds(cfg.step_deg_100),
+                     (uint32_t)cfg.step_delay_ms * 1000, start_us);
+    } else {
+      armProfiledMove(i, target_pw, cfg.profile, cfg.preset, start_us);
+    }
+  }
+  interrupts();
   
   sendResponse(RESP_OK);
 }
@@ -271,9 +1269,11 @@ void handleStopMove(Packet& pkt) {
   if (servo_idx == 0xFF) {
     for (uint8_t i = 0; i < 4; i++) {
       stepped_moves[i].active = false;
+      pending_plans[i].due = false;
     }
   } else if (servo_idx <= 3) {
     stepped_moves[servo_idx].active = false;
+    pending_plans[servo_idx].due = false;
   } else {
     sendResponse(RESP_ERROR);
     return;
@@ -290,8 +1290,7 @@ void handleGetMoveStatus(Packet& pkt) {
   }
   
   for (uint8_t i = 0; i < 4; i++) {
-    float current_deg = microsecondsToDegrees(servo_positions[i]);
-    uint16_t deg_100 = (uint16_t)(current_deg * 100);
+    uint16_t deg_100 = microsecondsToDeg100(servo_positions[i]);
     response[4 + i*2] = (deg_100 >> 8) & 0xFF;
     response[4 + i*2 + 1] = deg_100 & 0xFF;
   }
@@ -299,33 +1298,195 @@ void handleGetMoveStatus(Packet& pkt) {
   sendPacket(CMD_GET_MOVE_STATUS, response, 12);
 }
 
+// Called from the main loop: plans the profiled sequence steps the ISR
+// queued. The move starts when it is armed, at most one loop pass after the
+// step came due; the sequence schedule itself stays absolute.
+void armPendingPlans() {
+  for (uint8_t i = 0; i < 4; i++) {
+    if (!pending_plans[i].due) continue;
+    noInterrupts();
+    volatile PendingPlan* plan = &pending_plans[i];
+    if (plan->due) {
+      plan->due = false;
+      armProfiledMove(i, plan->target_pw, plan->profile, plan->preset, motion_clock_us);
+    }
+    interrupts();
+  }
+}
+
+// Runs from the motion ISR. Entries are scheduled in absolute microseconds
+// so timing error does not accumulate across a long or looping sequence.
+void processSequence(uint32_t now) {
+  volatile SequenceRunner* run = &sequence_runner;
+  
+  for (uint8_t n = 0; run->running && n < run->length; n++) {
+    if ((int32_t)(now - run->next_us) < 0) return;
+    
+    const SequenceEntry& entry = sequence[run->index];
+    if (entry.servo_idx < 4) {
+      volatile PendingPlan* plan = &pending_plans[entry.servo_idx];
+      stepped_moves[entry.servo_idx].active = false;
+      if (entry.profile == SEQ_IMMEDIATE) {
+        plan->due = false;
+        setServoMicroseconds(entry.servo_idx, entry.target_pw);
+      } else {
+        // Planned by armPendingPlans() in the main loop
+        plan->target_pw = entry.target_pw;
+        plan->profile = entry.profile;
+        plan->preset = entry.preset;
+        plan->due = true;
+      }
+    }
+    
+    if (++run->index >= run->length) {
+      run->index = 0;
+      run->loops_done++;
+      if (run->loops != 0 && run->loops_done >= run->loops) {
+        run->running = false;
+        return;
+      }
+    }
+    run->next_us += sequence[run->index].delay_us;
+  }
+}
+
+void noteIsrTiming(uint16_t entry_us, uint16_t exit_us) {
+  if (isr_stats.latency_sum_us > 0x80000000UL) {
+    isr_stats.latency_sum_us >>= 1;
+    isr_stats.count >>= 1;
+  }
+  isr_stats.latency_sum_us += entry_us;
+  isr_stats.count++;
+  if (entry_us > isr_stats.latency_max_us) isr_stats.latency_max_us = entry_us;
+  // A count that wrapped means the ISR overran a whole tick
+  uint16_t duration = exit_us >= entry_us ? exit_us - entry_us : MOTION_TICK_US;
+  if (duration > isr_stats.duration_max_us) isr_stats.duration_max_us = duration;
+}
+
+// Includes idle sleep, so the average mostly reflects how often interrupts
+// wake the loop; the maximum shows the longest stall of the main loop.
+void noteLoopPeriod() {
+  uint32_t now = micros();
+  if (loop_stats.last_us != 0) {
+    uint32_t period = now - loop_stats.last_us;
+    if (loop_stats.period_sum_us > 0x80000000UL) {
+      loop_stats.period_sum_us >>= 1;
+      loop_stats.period_count >>= 1;
+    }
+    loop_stats.period_sum_us += period;
+    loop_stats.period_count++;
+    if (period > loop_stats.period_max_us) loop_stats.period_max_us = period;
+  }
+  loop_stats.last_us = now;
+}
+
+// Timer ISR. Step deadlines are kept in absolute microseconds and advanced
+// by the interval, so jitter is bounded by MOTION_TICK_US and never
+// accumulates over a ramp.
 void processSteppedMoves() {
-  uint32_t current_time = millis();
+  // The timer counts up from the overflow that raised this interrupt, so its
+  // value on entry is the ISR latency and on exit the latency plus run time
+  uint16_t entry_us = motion_timer->getCount(MICROSEC_FORMAT);
+  uint32_t now = (motion_clock_us += MOTION_TICK_US);
+  processSequence(now);
   
   for (uint8_t i = 0; i < 4; i++) {
-    SteppedMove* move = &stepped_moves[i];
+    volatile SteppedMove* move = &stepped_moves[i];
     
     if (!move->active) continue;
     
-    if (current_time - move->last_step_time >= move->step_delay_ms) {
-      move->last_step_time = current_time;
-      
-      int32_t diff = move->target_pw - move->current_pw;
-      
-      if (abs(diff) <= move->step_size_pw) {
-        move->current_pw = move->target_pw;
+    if (move->profile != PROFILE_LINEAR) {
+      uint32_t elapsed = now - move->start_us;
+      uint16_t pw = move->target_pw;
+      if (elapsed < move->duration_us) {
+        uint32_t done = profileDistance(move, elapsed);
+        pw = (move->target_pw > move->start_pw) ? move->start_pw + done
+                                                 : move->start_pw - done;
+      } else {
         move->active = false;
+      }
+      if (pw != move->current_pw) {
+        move->current_pw = pw;
+        setServoMicroseconds(move->servo_idx, pw);
+      }
+      continue;
+    }
+    
+    if ((int32_t)(now - move->next_step_us) < 0) continue;
+    
+    move->next_step_us += move->step_interval_us;
+    
+    int32_t diff = (int32_t)move->target_pw - (int32_t)move->current_pw;
+    
+    if (abs(diff) <= move->step_size_pw) {
+      move->current_pw = move->target_pw;
+      move->active = false;
+    } else {
+      if (diff > 0) {
+        move->current_pw += move->step_size_pw;
       } else {
-        if (diff > 0) {
-          move->current_pw += move->step_size_pw;
-        } else {
-          move->current_pw -= move->step_size_pw;
-        }
+        move->current_pw -= move->step_size_pw;
       }
-      
-      setServoMicroseconds(move->servo_idx, move->current_pw);
     }
+    
+    setServoMicroseconds(move->servo_idx, move->current_pw);
   }
+  
+  noteIsrTiming(entry_us, motion_timer->getCount(MICROSEC_FORMAT));
+}
+
+// Frame: active-move bitmask, a 2-byte pulse width per servo, then sequence
+// running flag, index and loops done (2).
+void serviceStatusStream() {
+  if (!status_stream.enabled) return;
+  
+  uint32_t now = millis();
+  uint32_t elapsed = now - status_stream.last_push_time;
+  if (elapsed < STREAM_MIN_INTERVAL_MS) return;
+  
+  uint8_t active_mask = 0;
+  uint16_t positions[4];
+  noInterrupts();
+  for (uint8_t i = 0; i < 4; i++) {
+    if (stepped_moves[i].active) active_mask |= (1 << i);
+    positions[i] = servo_positions[i];
+  }
+  bool seq_running = sequence_runner.running;
+  uint8_t seq_index = sequence_runner.index;
+  uint16_t seq_loops = sequence_runner.loops_done;
+  interrupts();
+  
+  // Fold the running flag into the mask so start/stop counts as a change
+  if (seq_running) active_mask |= 0x80;
+  
+  bool changed = active_mask != status_stream.last_active_mask ||
+                 seq_index != status_stream.last_seq_index ||
+                 seq_loops != status_stream.last_seq_loops;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (positions[i] != status_stream.last_positions[i]) changed = true;
+  }
+  
+  bool heartbeat_due = status_stream.heartbeat_ms > 0 &&
+                       elapsed >= status_stream.heartbeat_ms;
+  if (!changed && !heartbeat_due) return;
+  
+  uint8_t frame[13];
+  frame[0] = active_mask & 0x0F;
+  for (uint8_t i = 0; i < 4; i++) {
+    frame[1 + i*2] = (positions[i] >> 8) & 0xFF;
+    frame[1 + i*2 + 1] = positions[i] & 0xFF;
+    status_stream.last_positions[i] = positions[i];
+  }
+  frame[9] = seq_running ? 1 : 0;
+  frame[10] = seq_index;
+  frame[11] = (seq_loops >> 8) & 0xFF;
+  frame[12] = seq_loops & 0xFF;
+  status_stream.last_active_mask = active_mask;
+  status_stream.last_seq_index = seq_index;
+  status_stream.last_seq_loops = seq_loops;
+  status_stream.last_push_time = now;
+  
+  sendPacket(CMD_STATUS_PUSH, frame, 13);
 }
 
 // ============================================================================
@@ -336,6 +1497,8 @@ void setup() {
   Serial.begin(115200);
   while (!Serial && millis() < 3000);
   
+  loadConfig();
+  
   for (uint8_t i = 0; i < 4; i++) {
     stepped_moves[i].active = false;
     stepped_moves[i].servo_idx = i;
@@ -343,6 +1506,20 @@ void setup() {
     servos[i].writeMicroseconds(PW_DEFAULT);
   }
   
+  for (uint8_t t = 0; t < TRIGGER_COUNT; t++) {
+    triggers[t].edge = TRIGGER_EDGE_OFF;
+    triggers[t].count = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+      triggers[t].actions[i].mode = TRIGGER_ACTION_NONE;
+    }
+    pinMode(TRIGGER_PINS[t], INPUT);
+  }
+  
+  motion_timer = new HardwareTimer(MOTION_TIMER);
+  motion_timer->setOverflow(MOTION_TICK_US, MICROSEC_FORMAT);
+  motion_timer->attachInterrupt(processSteppedMoves);
+  motion_timer->resume();
+  
   delay(500);
   
   uint8_t init_data[5] = {0x49, 0x4E, 0x49, 0x54, 0x00};
@@ -350,11 +1527,17 @@ void setup() {
 }
 
 void loop() {
-  processSteppedMoves();
+  noteLoopPeriod();
+  armPendingPlans();
+  pumpSerial();
+  serviceStatusStream();
   
   Packet pkt = receivePacket();
   
   if (pkt.valid) {
+    countFrame(&loop_stats.frames_handled);
+    reply_seq = pkt.has_seq ? pkt.seq : -1;
+    
     switch(pkt.cmd) {
       case CMD_PING:
         handlePing(pkt);
@@ -377,11 +1560,58 @@ void loop() {
       case CMD_GET_MOVE_STATUS:
         handleGetMoveStatus(pkt);
         break;
+      case CMD_SET_MANY:
+        handleSetMany(pkt);
+        break;
+      case CMD_MOVE_STEPPED_MANY:
+        handleMoveSteppedMany(pkt);
+        break;
+      case CMD_SUBSCRIBE:
+        handleSubscribe(pkt);
+        break;
+      case CMD_CONFIG_TRIGGER:
+        handleConfigTrigger(pkt);
+        break;
+      case CMD_ARM_TRIGGER:
+        handleArmTrigger(pkt);
+        break;
+      case CMD_GET_TRIGGER_STATUS:
+        handleGetTriggerStatus(pkt);
+        break;
+      case CMD_MOVE_PROFILE:
+        handleMoveProfile(pkt);
+        break;
+      case CMD_SEQ_UPLOAD:
+        handleSeqUpload(pkt);
+        break;
+      case CMD_SEQ_CONTROL:
+        handleSeqControl(pkt);
+        break;
+      case CMD_SEQ_STATUS:
+        handleSeqStatus(pkt);
+        break;
+      case CMD_GET_STATS:
+        handleGetStats(pkt);
+        break;
+      case CMD_SET_CONFIG:
+        handleSetConfig(pkt);
+        break;
+      case CMD_GET_CONFIG:
+        handleGetConfig(pkt);
+        break;
+      case CMD_SAVE_CONFIG:
+        handleSaveConfig(pkt);
+        break;
+      case CMD_MOVE_PRESET:
+        handleMovePreset(pkt);
+        break;
       default:
         sendResponse(RESP_ERROR);
         break;
     }
+    
+    reply_seq = -1;
+  } else if (IDLE_SLEEP && Serial.available() == 0 && rx_head == rx_tail) {
+    __WFI();  // woken by the UART RX, motion timer or SysTick interrupt
   }
-  
-  delay(1);
 }
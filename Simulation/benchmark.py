@@ -0,0 +1,257 @@
+# -*- coding: utf-8 -*-
+"""
+Command latency benchmark for the device workers on simulated hardware
+
+Loads ShutterWorker, QuadAOMWorker, ChameleonWorker and APTWorker from this
+repository, connects each to its simulator (see simulators.py) and times
+representative @remote calls plus the status() publish cycle. Prints
+p50/p99/mean/max in milliseconds per call; --json saves the numbers, together
+with each worker's own get_metrics() breakdown, so runs before and after a
+change can be compared.
+
+Run from the pylums folder (so the devices package and its helpers import):
+
+    python path/to/Simulation/benchmark.py --iterations 500
+    python path/to/Simulation/benchmark.py --devices shutter aom --baud 9600 --delay 0.002
+"""
+
+import argparse
+import contextlib
+import importlib
+import importlib.util
+import io
+import json
+import os
+import statistics
+import sys
+import tempfile
+import time
+import types
+
+import serial
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.dirname(HERE)
+sys.path.insert(0, HERE)
+
+import simulators  # noqa: E402
+
+
+def load_module(name, path):
+    spec = importlib.util.spec_from_file_location(name, path)
+    module = importlib.util.module_from_spec(spec)
+    sys.modules[name] = module
+    spec.loader.exec_module(module)
+    return module
+
+
+def ensure_package(name):
+    """ Imports a devices sub-package, or registers an empty one when pylums doesn't have it """
+    try:
+        return importlib.import_module(name)
+    except ImportError:
+        package = types.ModuleType(name)
+        package.__path__ = []
+        sys.modules[name] = package
+        return package
+
+
+@contextlib.contextmanager
+def patched(obj, name, value):
+    missing = object()
+    old = getattr(obj, name, missing)
+    setattr(obj, name, value)
+    try:
+        yield
+    finally:
+        if old is missing:
+            delattr(obj, name)
+        else:
+            setattr(obj, name, old)
+
+
+@contextlib.contextmanager
+def injected_module(name, module):
+    """ Makes "import name" return module for the duration of the block """
+    old = sys.modules.get(name)
+    sys.modules[name] = module
+    try:
+        yield
+    finally:
+        if old is None:
+            del sys.modules[name]
+        else:
+            sys.modules[name] = old
+
+
+def percentile(sorted_values, p):
+    """ Nearest-rank percentile of an already sorted list """
+    if not sorted_values:
+        return float("nan")
+    rank = max(int(round(p / 100.0 * len(sorted_values) + 0.5)) - 1, 0)
+    return sorted_values[min(rank, len(sorted_values) - 1)]
+
+
+def measure(func, iterations, warmup=5):
+    """ Returns the latencies of iterations calls of func(i) in milliseconds """
+    for i in range(warmup):
+        func(i)
+    samples = []
+    for i in range(iterations):
+        t = time.perf_counter()
+        func(i)
+        samples.append((time.perf_counter() - t) * 1000.0)
+    return samples
+
+
+def summarize(samples):
+    ordered = sorted(samples)
+    return {
+        "n": len(ordered),
+        "p50": percentile(ordered, 50),
+        "p99": percentile(ordered, 99),
+        "mean": statistics.fmean(ordered) if ordered else float("nan"),
+        "max": ordered[-1] if ordered else float("nan"),
+    }
+
+
+def publish_cycle(worker):
+    """ One status publish: build the status and serialize it as the publisher does """
+    return lambda i: json.dumps(worker.status())
+
+
+# Per device: set up the simulator, construct and initialize the worker, return the calls to time
+
+def bench_shutter(args, workdir):
+    module = load_module("sim_ServoShutter_mod", os.path.join(REPO, "ServoShutter", "ServoShutter_mod.py"))
+
+    def port(device, baud, timeout=None, **kwargs):
+        return simulators.ServoFirmwareSim(device, baud, timeout=timeout, processing_delay=args.delay)
+
+    worker = module.ShutterWorker(com="SIM", baud=args.baud, servo_count=1, pins=[1],
+                                  heartbeat_ms=100, port_cache=os.path.join(workdir, "servo_ports.json"),
+                                  delta_status=args.delta_status)
+    with patched(serial, "Serial", port):
+        worker.init_device()
+    if not worker._connected:
+        raise RuntimeError("ShutterWorker did not connect to the simulator")
+    return worker, [
+        ("move_immediate", lambda i: worker.move_immediate("open" if i % 2 else "close", 1)),
+        ("move_stepped", lambda i: worker.move_stepped("open" if i % 2 else "close", 1)),
+        ("state", lambda i: worker.state(1)),
+        ("status publish", publish_cycle(worker)),
+    ]
+
+
+def bench_aom(args, workdir):
+    module = load_module("sim_mcp", os.path.join(REPO, "AOM", "mcp.py"))
+
+    def port(device, baud, timeout=None, **kwargs):
+        return simulators.AAOptoSim(device, args.baud, timeout=timeout, processing_delay=args.delay)
+
+    worker = module.QuadAOMWorker(comport="SIM", calibration_dir=os.path.join(workdir, "calibration"),
+                                  delta_status=args.delta_status)
+    with patched(serial, "Serial", port):
+        worker.init_device()
+    worker.status()
+    return worker, [
+        ("configure_channel", lambda i: worker.configure_channel(1, power_raw=100 + i % 2)),
+        ("configure_channel (unchanged)", lambda i: worker.configure_channel(1, power_raw=100)),
+        ("read_status_from_device", lambda i: worker.read_status_from_device()),
+        ("status publish", publish_cycle(worker)),
+    ]
+
+
+def bench_chameleon(args, workdir):
+    module = load_module("sim_chameleon", os.path.join(REPO, "Chameleon", "chameleon.py"))
+    simulators.ChameleonResourceManager.options = {
+        "baud_rate": args.baud, "processing_delay": args.delay, "tune_time": 0.05}
+    pyvisa = types.ModuleType("pyvisa")
+    pyvisa.ResourceManager = simulators.ChameleonResourceManager
+
+    worker = module.ChameleonWorker("SIM", delta_status=args.delta_status)
+    with injected_module("pyvisa", pyvisa):
+        worker.init_device()
+    return worker, [
+        ("query ?VW", lambda i: worker.query("?VW")),
+        ("open/close_shutter_tunable",
+         lambda i: worker.open_shutter_tunable() if i % 2 else worker.close_shutter_tunable()),
+        ("set_wavelength", lambda i: worker.set_wavelength(800 + i % 2)),
+        ("status publish", publish_cycle(worker)),
+    ]
+
+
+def bench_apt(args, workdir):
+    package = ensure_package("devices.thorlabs")
+    module = load_module("devices.thorlabs.sim_apt", os.path.join(REPO, "Delayline", "apt.py"))
+    simulators.SimulatedMotor.call_delay = args.delay
+    backend = simulators.SimulatedAPT()
+    serial_number = backend.serials[0]
+
+    worker = module.APTWorker(delta_status=args.delta_status)
+    with patched(package, "apt_wrapper", backend):
+        worker.init_device()
+    return worker, [
+        ("get_position", lambda i: worker.get_position(serial_number)),
+        ("move_absolute", lambda i: worker.move_absolute(serial_number, 0.001 * (i % 2))),
+        ("is_stopped", lambda i: worker.is_stopped(serial_number)),
+        ("status publish", publish_cycle(worker)),
+    ]
+
+
+BENCHMARKS = {
+    "shutter": ("ShutterWorker", bench_shutter),
+    "aom": ("QuadAOMWorker", bench_aom),
+    "chameleon": ("ChameleonWorker", bench_chameleon),
+    "apt": ("APTWorker", bench_apt),
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Latency benchmark of the device workers on simulated hardware")
+    parser.add_argument("--devices", nargs="+", choices=sorted(BENCHMARKS), default=list(BENCHMARKS))
+    parser.add_argument("--iterations", type=int, default=200)
+    parser.add_argument("--baud", type=int, default=115200, help="simulated line rate (0 disables wire time)")
+    parser.add_argument("--delay", type=float, default=0.0005, help="simulated device processing delay per request in s")
+    parser.add_argument("--delta-status", action="store_true", help="benchmark with change-only status publishing")
+    parser.add_argument("--json", help="also write the results to this file")
+    parser.add_argument("--verbose", action="store_true", help="show the workers' own output")
+    args = parser.parse_args()
+
+    results = {}
+    metrics = {}
+    with tempfile.TemporaryDirectory() as workdir:
+        for key in args.devices:
+            label, setup = BENCHMARKS[key]
+            results[label] = {}
+            # The workers print every command; keep that out of the timings and the report
+            quiet = contextlib.nullcontext() if args.verbose else contextlib.redirect_stdout(io.StringIO())
+            try:
+                with quiet:
+                    worker, calls = setup(args, workdir)
+                    for name, func in calls:
+                        results[label][name] = summarize(measure(func, args.iterations))
+                    if hasattr(worker, "firmware_stats"):
+                        worker.firmware_stats()
+                    # The workers' own breakdown of where the time went, for the --json report
+                    metrics[label] = worker.get_metrics()
+            except Exception as e:
+                results[label] = {"error": str(e)}
+
+    print(f"{args.iterations} iterations, {args.baud} baud, {args.delay * 1000:.2f} ms device delay")
+    print(f"{'':40s} {'p50':>9s} {'p99':>9s} {'mean':>9s} {'max':>9s}  [ms]")
+    for label, calls in results.items():
+        print(label)
+        if "error" in calls:
+            print(f"  failed: {calls['error']}")
+            continue
+        for name, r in calls.items():
+            print(f"  {name:38s} {r['p50']:9.3f} {r['p99']:9.3f} {r['mean']:9.3f} {r['max']:9.3f}")
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"settings": vars(args), "results": results, "metrics": metrics}, f, indent=2)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,530 @@
+# -*- coding: utf-8 -*-
+"""
+Simulated device back-ends for running the workers without hardware
+
+Each simulator replaces the object a worker talks to: SimulatedPort stands in
+for serial.Serial, ChameleonSim for the pyvisa resource and the APT classes for
+the apt_wrapper module. They answer with the same bytes the real devices send,
+so the workers run unmodified on top of them.
+
+Timing is configurable: a reply becomes readable after processing_delay plus
+the time its bytes need on the wire at the given baud rate (10 bits per byte),
+which is what dominates command latency on the bench.
+"""
+
+import re
+import threading
+import time
+
+
+def wire_time(nbytes, baud):
+    """ Seconds needed to move nbytes over a UART at baud (8N1) """
+    return nbytes * 10.0 / baud if baud else 0.0
+
+
+class SimulatedPort:
+    """ Loopback serial port with the pyserial calls the workers use.
+
+        Subclasses implement handle(data), which is called from the device thread
+        with every chunk the host writes and answers through _reply(). """
+
+    def __init__(self, port="SIM", baudrate=115200, timeout=None, processing_delay=0.0005, **kwargs):
+        self.name = self.port = port
+        self.baudrate = baudrate
+        self.timeout = timeout
+        self.processing_delay = processing_delay
+        self.is_open = True
+        self._cond = threading.Condition()
+        self._rx = bytearray()  # host -> device, not yet handled
+        self._tx = []  # device -> host, (ready_at, bytes) in order
+        self._line_free_at = 0.0
+        self._thread = threading.Thread(target=self._run, daemon=True)
+        self._thread.start()
+
+    # pyserial API
+
+    @property
+    def in_waiting(self):
+        with self._cond:
+            return self._available()
+
+    def write(self, data):
+        with self._cond:
+            self._check_open()
+            self._rx += data
+            self._cond.notify_all()
+        return len(data)
+
+    def read(self, size=1):
+        deadline = None if self.timeout is None else time.monotonic() + self.timeout
+        with self._cond:
+            while True:
+                self._check_open()
+                if self._available() >= size:
+                    break
+                remaining = None if deadline is None else deadline - time.monotonic()
+                if remaining is not None and remaining <= 0:
+                    break
+                self._cond.wait(self._next_wakeup(remaining))
+            return self._take(size)
+
+    def read_until(self, expected=b"\n", size=None):
+        buf = bytearray()
+        while size is None or len(buf) < size:
+            chunk = self.read(1)
+            if not chunk:
+                break
+            buf += chunk
+            if buf.endswith(expected):
+                break
+        return bytes(buf)
+
+    def flush(self):
+        pass
+
+    def reset_input_buffer(self):
+        with self._cond:
+            self._tx.clear()
+
+    def reset_output_buffer(self):
+        pass
+
+    def close(self):
+        with self._cond:
+            self.is_open = False
+            self._cond.notify_all()
+
+    # Device side
+
+    def handle(self, data):
+        raise NotImplementedError
+
+    def _reply(self, data):
+        """ Queues data for the host; it becomes readable once it has crossed the wire """
+        with self._cond:
+            start = max(time.monotonic(), self._line_free_at)
+            self._line_free_at = start + wire_time(len(data), self.baudrate)
+            self._tx.append((self._line_free_at, bytes(data)))
+            self._cond.notify_all()
+
+    def _run(self):
+        while True:
+            with self._cond:
+                while not self._rx and self.is_open:
+                    self._cond.wait()
+                if not self.is_open:
+                    return
+                data = bytes(self._rx)
+                self._rx.clear()
+            # Bytes have to arrive before the device can act on them
+            time.sleep(self.processing_delay + wire_time(len(data), self.baudrate))
+            self.handle(data)
+
+    def _check_open(self):
+        if not self.is_open:
+            raise IOError(f"{self.name} is closed")
+
+    def _available(self):
+        now = time.monotonic()
+        return sum(len(data) for ready_at, data in self._tx if ready_at <= now)
+
+    def _next_wakeup(self, remaining):
+        """ Wait until the next queued chunk is due (or the read timeout, whichever is first) """
+        pending = [ready_at for ready_at, data in self._tx if ready_at > time.monotonic()]
+        if pending:
+            due = max(min(pending) - time.monotonic(), 0.0001)
+            return due if remaining is None else min(due, remaining)
+        return remaining
+
+    def _take(self, size):
+        now = time.monotonic()
+        out = bytearray()
+        while self._tx and self._tx[0][0] <= now and len(out) < size:
+            ready_at, data = self._tx[0]
+            n = size - len(out)
+            out += data[:n]
+            if n < len(data):
+                self._tx[0] = (ready_at, data[n:])
+            else:
+                self._tx.pop(0)
+        return bytes(out)
+
+
+class ServoFirmwareSim(SimulatedPort):
+    """ servo.ino binary protocol: v1 (0xAA) and v2 (0xAB, sequence numbered) framing """
+
+    PKT_START = 0xAA
+    PKT_START_SEQ = 0xAB
+    PKT_END = 0x55
+
+    CMD_PING = 0x01
+    CMD_SET_SERVO = 0x02
+    CMD_GET_SERVO = 0x03
+    CMD_GET_ALL = 0x04
+    CMD_MOVE_STEPPED = 0x05
+    CMD_GET_MOVE_STATUS = 0x07
+    CMD_SET_MANY = 0x08
+    CMD_MOVE_STEPPED_MANY = 0x09
+    CMD_SUBSCRIBE = 0x0A
+    CMD_STATUS_PUSH = 0x0B
+    CMD_MOVE_PROFILE = 0x0F
+    CMD_GET_STATS = 0x13
+    CMD_SET_CONFIG = 0x14
+    CMD_GET_CONFIG = 0x15
+    CMD_SAVE_CONFIG = 0x16
+    CMD_MOVE_PRESET = 0x17
+    # Firmware defaults: closed 900, open 1600, 2.55 deg steps, 12 ms, linear, preset 1
+    DEFAULT_CONFIG = bytes([0x03, 0x84, 0x06, 0x40, 255, 0, 12, 0x01])
+    RESP_OK = 0x00
+    RESP_ERROR = 0xFF
+
+    def __init__(self, *args, protocol_version=2, **kwargs):
+        super().__init__(*args, **kwargs)
+        self.protocol_version = protocol_version
+        self.positions = [1500] * 4
+        self.config = [self.DEFAULT_CONFIG] * 4
+        self.saved_config = list(self.config)
+        self._frame_buf = bytearray()
+        self.frames_handled = 0
+        self._heartbeat = None
+        self._push_event = threading.Event()
+        self._push_thread = None
+
+    def _send(self, cmd, data, seq=None):
+        data = bytes(data)
+        if seq is None:
+            frame = bytearray([self.PKT_START, len(data), cmd])
+            checksum = len(data) ^ cmd
+        else:
+            frame = bytearray([self.PKT_START_SEQ, len(data), seq, cmd])
+            checksum = len(data) ^ cmd ^ seq
+        for byte in data:
+            checksum ^= byte
+        frame += data + bytes([checksum, self.PKT_END])
+        self._reply(frame)
+
+    def _ack(self, seq, code=RESP_OK):
+        self._send(self.RESP_OK, [code], seq)
+
+    def _positions_bytes(self):
+        return b"".join(bytes([(pw >> 8) & 0xFF, pw & 0xFF]) for pw in self.positions)
+
+    def handle(self, data):
+        buf = self._frame_buf
+        buf += data
+        while buf:
+            if buf[0] not in (self.PKT_START, self.PKT_START_SEQ) or (
+                buf[0] == self.PKT_START_SEQ and self.protocol_version < 2
+            ):
+                del buf[0]
+                continue
+            header = 4 if buf[0] == self.PKT_START_SEQ else 3
+            if len(buf) < header or len(buf) < header + buf[1] + 2:
+                return
+            length = buf[1]
+            seq = buf[2] if header == 4 else None
+            cmd = buf[header - 1]
+            payload = bytes(buf[header : header + length])
+            del buf[: header + length + 2]
+            self.frames_handled += 1
+            self._dispatch(cmd, payload, seq)
+
+    def _dispatch(self, cmd, data, seq):
+        if cmd == self.CMD_PING:
+            version = bytes([self.protocol_version]) if self.protocol_version >= 2 else b""
+            self._send(self.CMD_PING, b"PONG" + version, seq)
+        elif cmd == self.CMD_SET_SERVO and len(data) == 3 and data[0] < 4:
+            self.positions[data[0]] = (data[1] << 8) | data[2]
+            self._ack(seq)
+            self._push_event.set()
+        elif cmd == self.CMD_GET_SERVO and len(data) == 1 and data[0] < 4:
+            pw = self.positions[data[0]]
+            self._send(self.CMD_GET_SERVO, [data[0], pw >> 8, pw & 0xFF], seq)
+        elif cmd == self.CMD_GET_ALL:
+            self._send(self.CMD_GET_ALL, self._positions_bytes(), seq)
+        elif cmd == self.CMD_SET_MANY and data:
+            fields = data[1:]
+            for idx in (i for i in range(4) if data[0] & (1 << i)):
+                self.positions[idx] = (fields[0] << 8) | fields[1]
+                fields = fields[2:]
+            self._ack(seq)
+            self._push_event.set()
+        elif cmd == self.CMD_MOVE_PROFILE:
+            # Moves complete instantly; report a nominal duration like the firmware does
+            self._send(self.RESP_OK, [self.RESP_OK, 0, 100], seq)
+        elif cmd == self.CMD_GET_MOVE_STATUS:
+            # Four active flags (moves complete instantly), then each position in 1/100 deg
+            deg100 = [(min(max(pw, 500), 2500) - 500) * 9 for pw in self.positions]
+            self._send(self.CMD_GET_MOVE_STATUS, bytes(4) + b"".join(bytes([d >> 8, d & 0xFF]) for d in deg100), seq)
+        elif cmd == self.CMD_GET_STATS:
+            # Loop period / ISR timings of an idle board at the default 50 us motion tick
+            fields = [50, 120, 2, 6, 9, 0, 0, min(self.frames_handled, 0xFFFF)]
+            self._send(self.CMD_GET_STATS, b"".join(bytes([v >> 8, v & 0xFF]) for v in fields) + bytes([8]), seq)
+            if data and data[0]:
+                self.frames_handled = 0
+        elif cmd == self.CMD_SET_CONFIG and len(data) == 9 and data[0] < 4:
+            pws = ((data[1] << 8) | data[2], (data[3] << 8) | data[4])
+            if all(500 <= pw <= 2500 for pw in pws) and data[5] and (data[8] >> 4) <= 2 and (data[8] & 0x0F) < 4:
+                self.config[data[0]] = bytes(data[1:])
+                self._ack(seq)
+            else:
+                self._ack(seq, self.RESP_ERROR)
+        elif cmd == self.CMD_GET_CONFIG:
+            self._send(self.CMD_GET_CONFIG, b"".join(self.config), seq)
+        elif cmd == self.CMD_SAVE_CONFIG:
+            if data and data[0] == 1:
+                self.config = [self.DEFAULT_CONFIG] * 4
+            self.saved_config = list(self.config)
+            self._ack(seq)
+        elif cmd == self.CMD_MOVE_PRESET and len(data) == 2:
+            # Stepped moves complete instantly as well
+            offset = 2 if data[1] & 0x01 else 0
+            for idx in (i for i in range(4) if data[0] & (1 << i)):
+                record = self.config[idx]
+                self.positions[idx] = (record[offset] << 8) | record[offset + 1]
+            self._ack(seq)
+            self._push_event.set()
+        elif cmd == self.CMD_SUBSCRIBE and len(data) == 3:
+            self._heartbeat = ((data[1] << 8) | data[2]) / 1000.0 if data[0] else None
+            self._ack(seq)
+            if self._heartbeat and self._push_thread is None:
+                self._push_thread = threading.Thread(target=self._push_loop, daemon=True)
+                self._push_thread.start()
+        else:
+            # Stepped moves, triggers, sequences: accept everything
+            self._ack(seq)
+
+    def _push_loop(self):
+        """ Unsolicited CMD_STATUS_PUSH on every change and at the heartbeat interval """
+        while self.is_open and self._heartbeat:
+            self._push_event.wait(self._heartbeat)
+            self._push_event.clear()
+            self._send(self.CMD_STATUS_PUSH, bytes([0]) + self._positions_bytes())
+
+
+class AAOptoSim(SimulatedPort):
+    """ AA Opto quad AOM driver: "q" identification, "S" status dump, L<ch>/B<ch> settings """
+
+    def __init__(self, *args, device_id=1234, **kwargs):
+        super().__init__(*args, **kwargs)
+        self.device_id = device_id
+        self.channels = {
+            ch: {"F": 110.0, "D": 10.0, "O": True, "I": True, "blanking": False, "blanking_int": True}
+            for ch in range(1, 5)
+        }
+        self._line = bytearray()
+
+    def _dump(self):
+        lines = []
+        for ch, c in self.channels.items():
+            lines.append("\n\rl%d F=%.2f P=%.2f %s %s" % (
+                ch, c["F"], c["D"], "ON" if c["O"] else "OFF", "INT" if c["I"] else "EXT"))
+        for ch, c in self.channels.items():
+            lines.append("\n\rb%d %s %s" % (
+                ch, "ON" if c["blanking"] else "OFF", "INT" if c["blanking_int"] else "EXT"))
+        return "".join(lines) + "\n\r?"
+
+    def _apply(self, command):
+        match = re.match(r"^([LB])([1-4])(.*)$", command)
+        if match is None:
+            return False
+        prefix, ch, rest = match.group(1), int(match.group(2)), match.group(3)
+        c = self.channels[ch]
+        for key, value in re.findall(r"([A-Z])(-?[\d.]+)", rest):
+            if prefix == "L" and key in ("F", "D"):
+                c[key] = float(value)
+            elif prefix == "L" and key == "P":
+                c["D"] = round(-5.2 + float(value) * 38.2 / 1023, 2)
+            elif prefix == "L" and key in ("O", "I"):
+                c[key] = value == "1"
+            elif prefix == "B" and key == "O":
+                c["blanking"] = value == "1"
+            elif prefix == "B" and key == "I":
+                c["blanking_int"] = value == "1"
+        return True
+
+    def handle(self, data):
+        for byte in data:
+            char = chr(byte)
+            if char == "S" and not self._line:
+                self._reply(self._dump().encode("ascii"))
+            elif char == "\r":
+                command = self._line.decode("ascii")
+                self._line.clear()
+                if command == "q":
+                    self._reply(b"QR%d \n\r?" % self.device_id)
+                elif self._apply(command):
+                    self._reply(command.encode("ascii") + b"\n\r?")
+                else:
+                    self._reply(b"?\n\r?")
+            else:
+                self._line.append(byte)
+
+
+class ChameleonSim:
+    """ Coherent Chameleon over VISA with ECHO on: query(cmd) returns cmd followed by the value """
+
+    def __init__(self, resource="SIM", baud_rate=19200, processing_delay=0.002, tune_time=0.5):
+        self.resource_name = resource
+        self.baud_rate = baud_rate
+        self.write_termination = "\r\n"
+        self.read_termination = "\r\n"
+        self.processing_delay = processing_delay
+        self.tune_time = tune_time
+        self._lock = threading.Lock()
+        self._tune_until = 0.0
+        self.values = {
+            "ST": "Starting",
+            "K": "1",
+            "L": "1",
+            "VW": "800",
+            "PVAR": "1500",
+            "PFIXED": "1200",
+            "SVAR": "0",
+            "SFIXED": "0",
+            "ALIGNVAR": "0",
+            "ALIGNFIXED": "0",
+        }
+        self._setters = {"WV": "VW", "L": "L", "SVAR": "SVAR", "SFIXED": "SFIXED",
+                         "ALIGNVAR": "ALIGNVAR", "ALIGNFIXED": "ALIGNFIXED"}
+
+    def _answer(self, command):
+        if command == "?TS":
+            return "1" if time.monotonic() < self._tune_until else "0"
+        if command.startswith("?"):
+            return self.values.get(command[1:], "")
+        key, _, value = command.partition("=")
+        if key in self._setters:
+            self.values[self._setters[key]] = value
+            if key == "WV":
+                self._tune_until = time.monotonic() + self.tune_time
+        return ""
+
+    def query(self, command):
+        # The laser serves one query at a time, like the real RS-232 link
+        with self._lock:
+            nbytes = len(command) + len(self.write_termination)
+            reply = command + self._answer(command)
+            nbytes += len(reply) + len(self.read_termination)
+            time.sleep(self.processing_delay + wire_time(nbytes, self.baud_rate))
+            return reply
+
+    def close(self):
+        pass
+
+
+class ChameleonResourceManager:
+    """ Drop-in for pyvisa.ResourceManager handing out ChameleonSim instances """
+
+    options = {}
+
+    def open_resource(self, resource):
+        return ChameleonSim(resource, **self.options)
+
+
+class SimulatedMotor:
+    """ Thorlabs APT motor as seen through apt_wrapper.Motor; every call costs call_delay """
+
+    call_delay = 0.001
+    max_velocity = 2.0  # mm/s
+    home_time = 0.5
+
+    def __init__(self, serial_number):
+        self.serial_number = serial_number
+        self.acceleration = 5
+        self.maximum_velocity = self.max_velocity
+        self._params = (0.0, 5.0, self.max_velocity)
+        self._lock = threading.Lock()
+        self._start = 0.0
+        self._target = 0.0
+        self._t0 = 0.0
+        self._duration = 0.0
+        self._velocity = 0.0
+        self._homed = False
+        self._homing_until = 0.0
+
+    def _call(self):
+        time.sleep(self.call_delay)
+
+    def _position_at(self, now):
+        if self._velocity:
+            return self._start + self._velocity * (now - self._t0)
+        if self._duration <= 0:
+            return self._target
+        f = min((now - self._t0) / self._duration, 1.0)
+        return self._start + (self._target - self._start) * f
+
+    @property
+    def position(self):
+        self._call()
+        with self._lock:
+            return self._position_at(time.monotonic())
+
+    @property
+    def is_in_motion(self):
+        self._call()
+        with self._lock:
+            now = time.monotonic()
+            if now < self._homing_until:
+                return True
+            return bool(self._velocity) or now - self._t0 < self._duration
+
+    @property
+    def has_homing_been_completed(self):
+        self._call()
+        return self._homed and time.monotonic() >= self._homing_until
+
+    def homed(self):
+        return self.has_homing_been_completed
+
+    def get_velocity_parameters(self):
+        self._call()
+        return self._params
+
+    def set_velocity_parameters(self, min_vel, accn, max_vel):
+        self._call()
+        self._params = (min_vel, accn, max_vel)
+        self.maximum_velocity = max_vel
+
+    def move_to(self, target):
+        self._call()
+        with self._lock:
+            now = time.monotonic()
+            self._start = self._position_at(now)
+            self._velocity = 0.0
+            self._target = float(target)
+            self._t0 = now
+            self._duration = abs(self._target - self._start) / max(self.maximum_velocity, 1e-6)
+
+    def move_velocity(self, direction):
+        self._call()
+        with self._lock:
+            now = time.monotonic()
+            self._start = self._position_at(now)
+            self._t0 = now
+            self._velocity = self.maximum_velocity * (1 if direction == 1 else -1)
+
+    def stop_profiled(self):
+        self._call()
+        with self._lock:
+            now = time.monotonic()
+            self._target = self._start = self._position_at(now)
+            self._velocity = 0.0
+            self._duration = 0.0
+
+    def move_home(self, blocking=False):
+        self._call()
+        self.move_to(0.0)
+        self._homing_until = time.monotonic() + self.home_time
+        self._homed = True
+
+
+class SimulatedAPT:
+    """ Stand-in for the apt_wrapper module: list_available_devices() and Motor """
+
+    def __init__(self, serials=(83000001,)):
+        self.serials = list(serials)
+        self.Motor = SimulatedMotor
+
+    def list_available_devices(self):
+        return [(31, n) for n in self.serials]